@@ -0,0 +1,555 @@
+/**
+ * bench.c: 基于 libmydb 的微基准测试
+ * 说明: 依次运行顺序插入、随机插入、点查、全表扫描、范围扫描和读写混合负载，
+ *      每种负载输出吞吐、延迟分位数、读写页数和每行占用的字节数（CSV 或 JSON）。
+ *      分页器选项与 REPL 相同，便于比较不同配置；点查和范围扫描可以用多个线程并发运行
+ */
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "mydb.h"
+
+#define BENCH_DEFAULT_ROWS 100000
+#define BENCH_DEFAULT_RANGE 100         // 范围扫描每次读取的行数
+#define BENCH_DEFAULT_READ_PERCENT 90   // 混合负载中读操作的比例
+#define BENCH_FILENAME_SIZE 512
+
+typedef enum{
+    WORKLOAD_SEQ_INSERT,
+    WORKLOAD_RAND_INSERT,
+    WORKLOAD_POINT_LOOKUP,
+    WORKLOAD_FULL_SCAN,
+    WORKLOAD_RANGE_SCAN,
+    WORKLOAD_MIXED,
+    NUM_WORKLOADS
+}Workload;
+
+const char* workload_names[NUM_WORKLOADS] = {
+    "seq_insert", "rand_insert", "point_lookup", "full_scan", "range_scan", "mixed"
+};
+
+typedef enum { FORMAT_CSV, FORMAT_JSON }OutputFormat;
+
+/**
+ * BenchConfig 基准测试配置
+ * rows: 表中的行数，插入负载插入这么多行
+ * ops: 点查、范围扫描和混合负载的操作数，0 表示与 rows 相同
+ * range: 范围扫描每次读取的行数
+ * read_percent: 混合负载中读操作的百分比
+ * selected: 要运行的负载
+ * threads: 点查和范围扫描的并发线程数，每个线程打开自己的句柄
+ * directory: 存放临时数据库文件的目录
+ * keep: 结束后保留数据库文件
+ */
+typedef struct{
+    uint32_t rows;
+    uint32_t ops;
+    uint32_t range;
+    uint32_t read_percent;
+    uint32_t seed;
+    uint32_t threads;
+    bool selected[NUM_WORKLOADS];
+    const char* directory;
+    bool keep;
+    OutputFormat format;
+    mydb_options options;
+}BenchConfig;
+
+/**
+ * BenchResult 一种负载的测量结果
+ * ops: 完成的操作数
+ * seconds: 总耗时，包括写负载最后的检查点
+ * latencies: 每次操作的耗时（纳秒）
+ * stats: 负载期间的读写计数
+ * num_rows: 负载结束时表中的行数
+ * threads: 运行负载的线程数
+ */
+typedef struct{
+    Workload workload;
+    uint32_t threads;
+    uint64_t ops;
+    double seconds;
+    uint64_t* latencies;
+    mydb_stats stats;
+    uint32_t num_rows;
+}BenchResult;
+
+uint64_t now_ns(){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/**
+ * next_random: xorshift64，避免 rand() 的周期和锁开销影响测量；读线程各用自己的状态
+ */
+uint64_t random_state = 88172645463325252ull;
+
+uint64_t next_random_from(uint64_t* state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+uint64_t next_random(){
+    return next_random_from(&random_state);
+}
+
+void check(mydb* db, int rc, const char* what){
+    if(rc != MYDB_OK){
+        fprintf(stderr, "%s failed (%d): %s\n", what, rc, mydb_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+}
+
+void remove_database(const char* filename){
+    char wal_filename[BENCH_FILENAME_SIZE + 8];
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+    unlink(filename);
+    unlink(wal_filename);
+}
+
+mydb* open_database(BenchConfig* config, const char* filename){
+    mydb* db;
+    int rc = mydb_open(filename, &config->options, &db);
+    if(rc != MYDB_OK){
+        fprintf(stderr, "Cannot open %s: %s\n", filename, mydb_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+    return db;
+}
+
+/**
+ * insert_row: 插入一行，用户名和邮箱由 id 生成，长度随 id 变化
+ */
+void insert_row(mydb* db, mydb_stmt* stmt, uint32_t id){
+    char username[MYDB_USERNAME_MAX + 1];
+    char email[MYDB_EMAIL_MAX + 1];
+    int username_length = snprintf(username, sizeof(username), "user%u", id);
+    int email_length = snprintf(email, sizeof(email), "user%u@example.com", id);
+    mydb_bind_id(stmt, id);
+    mydb_bind_username(stmt, username, username_length);
+    mydb_bind_email(stmt, email, email_length);
+    int rc = mydb_step(stmt);
+    // 组提交中的插入稍后随同一组一起落盘
+    check(db, rc == MYDB_PENDING ? MYDB_OK : rc, "insert");
+    mydb_reset(stmt);
+}
+
+/**
+ * shuffled_ids: 返回 1..count 的随机排列
+ */
+uint32_t* shuffled_ids(uint32_t count){
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * count);
+    for(uint32_t i = 0; i < count; i++){
+        ids[i] = i + 1;
+    }
+    for(uint32_t i = count - 1; i > 0; i--){
+        uint32_t j = next_random() % (i + 1);
+        uint32_t temp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = temp;
+    }
+    return ids;
+}
+
+/**
+ * run_reads: 在 db 上运行 ops 次点查或范围扫描，每次操作的耗时写入 latencies
+ */
+void run_reads(BenchConfig* config, Workload workload, mydb* db, uint32_t ops, uint64_t* state,
+               uint64_t* latencies){
+    mydb_row row;
+    mydb_iter* iter;
+    for(uint32_t i = 0; i < ops; i++){
+        uint32_t first = next_random_from(state) % config->rows + 1;
+        uint64_t op_start = now_ns();
+        if(workload == WORKLOAD_POINT_LOOKUP){
+            check(db, mydb_get(db, first, &row), "get");
+        }
+        else{
+            // 每次扫描 range 行算一次操作
+            check(db, mydb_scan_open(db, first, first + config->range - 1, &iter), "scan");
+            int rc;
+            while((rc = mydb_scan_next(iter, &row)) == MYDB_ROW){
+            }
+            mydb_scan_close(iter);
+            check(db, rc == MYDB_DONE ? MYDB_OK : rc, "scan");
+        }
+        latencies[i] = now_ns() - op_start;
+    }
+}
+
+/**
+ * ReaderThread 并发读负载中一个线程的参数
+ * ops / latencies: 该线程分到的操作数和它在结果数组中的那一段
+ */
+typedef struct{
+    BenchConfig* config;
+    Workload workload;
+    const char* filename;
+    uint32_t ops;
+    uint64_t random_state;
+    uint64_t* latencies;
+}ReaderThread;
+
+void* reader_thread_main(void* arg){
+    ReaderThread* reader = (ReaderThread*)arg;
+    // 同一文件的句柄共享引擎，各线程的读操作只在页闩上竞争
+    mydb* db = open_database(reader->config, reader->filename);
+    run_reads(reader->config, reader->workload, db, reader->ops, &reader->random_state, reader->latencies);
+    check(db, mydb_close(db), "close");
+    return NULL;
+}
+
+/**
+ * run_parallel_reads: 用 config->threads 个线程分摊 ops 次读操作，主线程的 db 保持打开
+ */
+void run_parallel_reads(BenchConfig* config, Workload workload, const char* filename, uint32_t ops,
+                        uint64_t* latencies){
+    uint32_t num_threads = config->threads;
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * num_threads);
+    ReaderThread* readers = (ReaderThread*)malloc(sizeof(ReaderThread) * num_threads);
+    uint32_t offset = 0;
+    for(uint32_t i = 0; i < num_threads; i++){
+        ReaderThread* reader = &readers[i];
+        reader->config = config;
+        reader->workload = workload;
+        reader->filename = filename;
+        reader->ops = ops / num_threads + (i < ops % num_threads ? 1 : 0);
+        reader->random_state = next_random() | 1;
+        reader->latencies = latencies + offset;
+        offset += reader->ops;
+        if(pthread_create(&threads[i], NULL, reader_thread_main, reader) != 0){
+            fprintf(stderr, "Cannot create reader thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(uint32_t i = 0; i < num_threads; i++){
+        pthread_join(threads[i], NULL);
+    }
+    free(readers);
+    free(threads);
+}
+
+/**
+ * run_workload: 在 db 上运行一种负载并测量
+ * 说明: 每次操作单独计时；写负载最后做一次检查点，让脏页的写回也计入页数和总耗时
+ */
+void run_workload(BenchConfig* config, Workload workload, const char* filename, mydb* db, BenchResult* result){
+    uint32_t ops = config->ops != 0 ? config->ops : config->rows;
+    uint64_t capacity = workload == WORKLOAD_SEQ_INSERT || workload == WORKLOAD_RAND_INSERT ||
+                        workload == WORKLOAD_FULL_SCAN ? config->rows : ops;
+    result->workload = workload;
+    result->latencies = (uint64_t*)malloc(sizeof(uint64_t) * (capacity > 0 ? capacity : 1));
+    result->ops = 0;
+    result->num_rows = config->rows;
+    bool parallel = workload == WORKLOAD_POINT_LOOKUP || workload == WORKLOAD_RANGE_SCAN;
+    result->threads = parallel && config->threads > 1 ? config->threads : 1;
+
+    uint32_t* ids = workload == WORKLOAD_RAND_INSERT ? shuffled_ids(config->rows) : NULL;
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    mydb_row row;
+    mydb_iter* iter;
+    bool writes = false;
+
+    mydb_stats_reset(db);
+    uint64_t start = now_ns();
+    switch(workload){
+        case WORKLOAD_SEQ_INSERT:
+        case WORKLOAD_RAND_INSERT:
+            writes = true;
+            for(uint32_t i = 0; i < config->rows; i++){
+                uint64_t op_start = now_ns();
+                insert_row(db, stmt, ids != NULL ? ids[i] : i + 1);
+                result->latencies[result->ops++] = now_ns() - op_start;
+            }
+            break;
+        case WORKLOAD_POINT_LOOKUP:
+        case WORKLOAD_RANGE_SCAN:
+            if(config->threads > 1){
+                run_parallel_reads(config, workload, filename, ops, result->latencies);
+            }
+            else{
+                run_reads(config, workload, db, ops, &random_state, result->latencies);
+            }
+            result->ops = ops;
+            break;
+        case WORKLOAD_FULL_SCAN:
+            // 每产出一行算一次操作
+            check(db, mydb_scan_open(db, 0, UINT32_MAX, &iter), "scan");
+            while(true){
+                uint64_t op_start = now_ns();
+                int rc = mydb_scan_next(iter, &row);
+                if(rc != MYDB_ROW){
+                    check(db, rc == MYDB_DONE ? MYDB_OK : rc, "scan");
+                    break;
+                }
+                result->latencies[result->ops++] = now_ns() - op_start;
+            }
+            mydb_scan_close(iter);
+            break;
+        case WORKLOAD_MIXED:
+            // 读随机的已有行，写在表尾追加新行
+            writes = true;
+            for(uint32_t i = 0; i < ops; i++){
+                bool read = next_random() % 100 < config->read_percent;
+                uint64_t op_start = now_ns();
+                if(read){
+                    check(db, mydb_get(db, next_random() % config->rows + 1, &row), "get");
+                }
+                else{
+                    insert_row(db, stmt, ++result->num_rows);
+                }
+                result->latencies[result->ops++] = now_ns() - op_start;
+            }
+            break;
+        default:
+            break;
+    }
+    if(writes){
+        check(db, mydb_checkpoint(db), "checkpoint");
+    }
+    result->seconds = (now_ns() - start) / 1e9;
+    check(db, mydb_stats_get(db, &result->stats), "stats");
+
+    mydb_finalize(stmt);
+    free(ids);
+}
+
+int compare_uint64(const void* a, const void* b){
+    uint64_t value_a = *(const uint64_t*)a;
+    uint64_t value_b = *(const uint64_t*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * percentile_us: 已排序的延迟数组中第 p 分位的值（微秒）
+ */
+double percentile_us(uint64_t* sorted, uint64_t count, double p){
+    if(count == 0){
+        return 0;
+    }
+    uint64_t index = (uint64_t)(p * count);
+    if(index >= count){
+        index = count - 1;
+    }
+    return sorted[index] / 1000.0;
+}
+
+void print_header(BenchConfig* config){
+    if(config->format == FORMAT_CSV){
+        printf("workload,rows,threads,ops,seconds,ops_per_sec,p50_us,p99_us,p999_us,"
+               "pages_read,pages_written,cache_hits,cache_misses,syncs,db_pages,bytes_per_row\n");
+    }
+    else{
+        printf("[");
+    }
+}
+
+void print_result(BenchConfig* config, BenchResult* result, bool first){
+    qsort(result->latencies, result->ops, sizeof(uint64_t), compare_uint64);
+    double ops_per_sec = result->seconds > 0 ? result->ops / result->seconds : 0;
+    double p50 = percentile_us(result->latencies, result->ops, 0.50);
+    double p99 = percentile_us(result->latencies, result->ops, 0.99);
+    double p999 = percentile_us(result->latencies, result->ops, 0.999);
+    mydb_stats* stats = &result->stats;
+    double bytes_per_row = result->num_rows > 0 ?
+                           (double)stats->page_count * stats->page_size / result->num_rows : 0;
+
+    if(config->format == FORMAT_CSV){
+        printf("%s,%u,%u,%" PRIu64 ",%.6f,%.0f,%.3f,%.3f,%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+               ",%" PRIu64 ",%u,%.1f\n",
+               workload_names[result->workload], result->num_rows, result->threads, result->ops,
+               result->seconds, ops_per_sec, p50, p99, p999, stats->pages_read, stats->pages_written,
+               stats->cache_hits, stats->cache_misses, stats->syncs, stats->page_count, bytes_per_row);
+    }
+    else{
+        printf("%s\n  {\"workload\": \"%s\", \"rows\": %u, \"threads\": %u, \"ops\": %" PRIu64 ", \"seconds\": %.6f, "
+               "\"ops_per_sec\": %.0f, \"p50_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, "
+               "\"pages_read\": %" PRIu64 ", \"pages_written\": %" PRIu64 ", \"cache_hits\": %" PRIu64
+               ", \"cache_misses\": %" PRIu64 ", \"syncs\": %" PRIu64 ", \"db_pages\": %u, \"bytes_per_row\": %.1f}",
+               first ? "" : ",", workload_names[result->workload], result->num_rows, result->threads, result->ops,
+               result->seconds, ops_per_sec, p50, p99, p999, stats->pages_read, stats->pages_written,
+               stats->cache_hits, stats->cache_misses, stats->syncs, stats->page_count, bytes_per_row);
+    }
+    fflush(stdout);
+}
+
+void print_usage(const char* program){
+    fprintf(stderr,
+            "Usage: %s [--rows N] [--ops N] [--range N] [--read-percent P] [--seed N] [--threads N]\n"
+            "          [--workloads seq_insert,rand_insert,point_lookup,full_scan,range_scan,mixed]\n"
+            "          [--pool-frames N] [--wal [--wal-group N]] [--mmap [--mmap-size MB]]\n"
+            "          [--page-size bytes] [--huge-pages] [--direct-io]\n"
+            "          [--format csv|json] [--dir path] [--keep]\n", program);
+}
+
+/**
+ * parse_workloads: 解析逗号分隔的负载名列表
+ */
+bool parse_workloads(char* list, bool* selected){
+    memset(selected, 0, sizeof(bool) * NUM_WORKLOADS);
+    for(char* name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")){
+        int found = -1;
+        for(int i = 0; i < NUM_WORKLOADS; i++){
+            if(strcmp(name, workload_names[i]) == 0){
+                found = i;
+            }
+        }
+        if(found == -1){
+            fprintf(stderr, "Unknown workload '%s'\n", name);
+            return false;
+        }
+        selected[found] = true;
+    }
+    return true;
+}
+
+int main(int argc, char** argv){
+    BenchConfig config;
+    memset(&config, 0, sizeof(config));
+    config.rows = BENCH_DEFAULT_ROWS;
+    config.range = BENCH_DEFAULT_RANGE;
+    config.read_percent = BENCH_DEFAULT_READ_PERCENT;
+    config.directory = ".";
+    config.format = FORMAT_CSV;
+    for(int i = 0; i < NUM_WORKLOADS; i++){
+        config.selected[i] = true;
+    }
+    mydb_options_init(&config.options);
+
+    for(int i = 1; i < argc; i++){
+        bool has_value = i + 1 < argc;
+        if(strcmp(argv[i], "--rows") == 0 && has_value){
+            config.rows = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--ops") == 0 && has_value){
+            config.ops = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--range") == 0 && has_value){
+            config.range = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--read-percent") == 0 && has_value){
+            config.read_percent = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--seed") == 0 && has_value){
+            config.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--threads") == 0 && has_value){
+            config.threads = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--workloads") == 0 && has_value){
+            if(!parse_workloads(argv[++i], config.selected)){
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(strcmp(argv[i], "--pool-frames") == 0 && has_value){
+            config.options.pool_frames = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--wal") == 0){
+            config.options.use_wal = true;
+        }
+        else if(strcmp(argv[i], "--wal-group") == 0 && has_value){
+            config.options.wal_group_commit = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--mmap") == 0){
+            config.options.use_mmap = true;
+        }
+        else if(strcmp(argv[i], "--mmap-size") == 0 && has_value){
+            config.options.mmap_size = (size_t)strtoul(argv[++i], NULL, 10) * 1024 * 1024;
+        }
+        else if(strcmp(argv[i], "--page-size") == 0 && has_value){
+            config.options.page_size = (uint32_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if(strcmp(argv[i], "--huge-pages") == 0){
+            config.options.use_huge_pages = true;
+        }
+        else if(strcmp(argv[i], "--direct-io") == 0){
+            config.options.use_direct_io = true;
+        }
+        else if(strcmp(argv[i], "--format") == 0 && has_value){
+            i++;
+            if(strcmp(argv[i], "csv") == 0){
+                config.format = FORMAT_CSV;
+            }
+            else if(strcmp(argv[i], "json") == 0){
+                config.format = FORMAT_JSON;
+            }
+            else{
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        else if(strcmp(argv[i], "--dir") == 0 && has_value){
+            config.directory = argv[++i];
+        }
+        else if(strcmp(argv[i], "--keep") == 0){
+            config.keep = true;
+        }
+        else{
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(config.rows == 0 || config.range == 0 || config.read_percent > 100 ||
+       (config.threads > 1 && config.options.use_mmap)){
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if(config.seed != 0){
+        random_state ^= (uint64_t)config.seed * 0x9e3779b97f4a7c15ull;
+    }
+
+    // 顺序插入单独用一个文件；随机插入建好的表供后面的读负载和混合负载使用
+    char seq_filename[BENCH_FILENAME_SIZE];
+    char filename[BENCH_FILENAME_SIZE];
+    snprintf(seq_filename, sizeof(seq_filename), "%s/bench-seq.db", config.directory);
+    snprintf(filename, sizeof(filename), "%s/bench.db", config.directory);
+    remove_database(seq_filename);
+    remove_database(filename);
+
+    // 只选了读负载时，先不计时地用随机插入建好表
+    bool any_reads = false;
+    for(int i = WORKLOAD_POINT_LOOKUP; i < NUM_WORKLOADS; i++){
+        any_reads = any_reads || config.selected[i];
+    }
+
+    print_header(&config);
+    bool first = true;
+    for(int i = 0; i < NUM_WORKLOADS; i++){
+        Workload workload = (Workload)i;
+        bool load_only = workload == WORKLOAD_RAND_INSERT && !config.selected[i] && any_reads;
+        if(!config.selected[i] && !load_only){
+            continue;
+        }
+
+        // 每种负载都重新打开，从冷的缓冲池开始
+        const char* workload_filename = workload == WORKLOAD_SEQ_INSERT ? seq_filename : filename;
+        mydb* db = open_database(&config, workload_filename);
+        BenchResult result;
+        run_workload(&config, workload, workload_filename, db, &result);
+        check(db, mydb_close(db), "close");
+        if(!load_only){
+            print_result(&config, &result, first);
+            first = false;
+        }
+        free(result.latencies);
+    }
+    if(config.format == FORMAT_JSON){
+        printf("\n]\n");
+    }
+
+    if(!config.keep){
+        remove_database(seq_filename);
+        remove_database(filename);
+    }
+    return 0;
+}
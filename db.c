@@ -0,0 +1,4573 @@
+/* https://cstack.github.io/db_tutorial/parts/part1.html --项目地址*/
+
+#include "db.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+__thread jmp_buf* db_error_jump = NULL;
+__thread char db_error_message[DB_ERROR_MESSAGE_SIZE];
+
+/**
+ * db_fail: 报告无法继续的引擎错误
+ */
+void db_fail(const char* format, ...){
+    va_list args;
+    va_start(args, format);
+    vsnprintf(db_error_message, sizeof(db_error_message), format, args);
+    va_end(args);
+    if(db_error_jump != NULL){
+        longjmp(*db_error_jump, 1);
+    }
+    printf("%s\n", db_error_message);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * HeldKind 线程持有的资源种类
+ * HELD_MUTEX: 缓冲池锁或写者锁
+ * HELD_PIN: get_page 钉住的页
+ * HELD_LATCH: get_page_latched 钉住并加了页锁的页
+ */
+typedef enum{
+    HELD_MUTEX,
+    HELD_PIN,
+    HELD_LATCH
+}HeldKind;
+
+/**
+ * HeldResource 线程持有的一个资源
+ * owner: HELD_MUTEX 时为互斥锁，否则为分页器
+ * page_num: 页号
+ */
+typedef struct{
+    HeldKind kind;
+    void* owner;
+    uint32_t page_num;
+}HeldResource;
+
+// 本线程持有的资源，按取得的先后排列
+static __thread HeldResource db_held[DB_MAX_HELD];
+static __thread uint32_t db_num_held = 0;
+
+static void held_push(HeldKind kind, void* owner, uint32_t page_num){
+    if(db_num_held == DB_MAX_HELD){
+        db_fail("Too many locks and pages held by one thread.");
+    }
+    db_held[db_num_held].kind = kind;
+    db_held[db_num_held].owner = owner;
+    db_held[db_num_held].page_num = page_num;
+    db_num_held++;
+}
+
+/**
+ * held_remove: 去掉最近取得的一个匹配的资源
+ * 说明: 后面的记录依次前移，保持先后顺序，外层跳转点的记录不会混进内层；
+ *      找不到时什么都不做（例如迭代器在另一个线程中打开时钉住的页）
+ */
+static void held_remove(HeldKind kind, void* owner, uint32_t page_num){
+    for(uint32_t i = db_num_held; i > 0; i--){
+        HeldResource* held = &db_held[i - 1];
+        if(held->kind == kind && held->owner == owner && held->page_num == page_num){
+            memmove(held, held + 1, sizeof(HeldResource) * (db_num_held - i));
+            db_num_held--;
+            return;
+        }
+    }
+}
+
+uint32_t db_held_mark(void){
+    return db_num_held;
+}
+
+void db_forget_held(uint32_t mark){
+    db_num_held = mark;
+}
+
+static int32_t pager_lookup(Pager* pager, uint32_t page_num);
+
+/**
+ * db_release_held: 从 db_fail 跳回后放开 mark 之后取得的锁和页
+ * 说明: 先放开互斥锁（放开页时还要再拿缓冲池锁），再逐页去掉页锁和引用
+ */
+void db_release_held(uint32_t mark){
+    for(uint32_t i = db_num_held; i > mark; i--){
+        HeldResource* held = &db_held[i - 1];
+        if(held->kind == HELD_MUTEX){
+            pthread_mutex_unlock((pthread_mutex_t*)held->owner);
+        }
+    }
+    for(uint32_t i = db_num_held; i > mark; i--){
+        HeldResource* held = &db_held[i - 1];
+        if(held->kind == HELD_MUTEX){
+            continue;
+        }
+        Pager* pager = (Pager*)held->owner;
+        pthread_mutex_lock(&pager->mutex);
+        if(pager->use_mmap){
+            pager->map_pins--;
+        }
+        else{
+            int32_t frame_index = pager_lookup(pager, held->page_num);
+            if(frame_index != -1 && pager->frames[frame_index].pin_count > 0){
+                if(held->kind == HELD_LATCH){
+                    pthread_rwlock_unlock(&pager->frames[frame_index].latch);
+                }
+                pager->frames[frame_index].pin_count--;
+            }
+        }
+        pthread_mutex_unlock(&pager->mutex);
+    }
+    db_num_held = mark;
+}
+
+/**
+ * db_mutex_lock / db_mutex_unlock: 加锁、解锁并记入本线程持有的资源
+ */
+void db_mutex_lock(pthread_mutex_t* mutex){
+    held_push(HELD_MUTEX, mutex, 0);
+    pthread_mutex_lock(mutex);
+}
+
+void db_mutex_unlock(pthread_mutex_t* mutex){
+    held_remove(HELD_MUTEX, mutex, 0);
+    pthread_mutex_unlock(mutex);
+}
+
+/**
+ * NodeType 节点类型
+ * NODE_INTERNAL: 内部节点
+ * NODE_LEAF: 叶子节点
+ */
+typedef enum {
+    NODE_INTERNAL,
+    NODE_LEAF
+} NodeType;
+
+/**
+ * 公共头结点布局
+ */
+static const uint32_t NODE_TYPE_SIZE = sizeof(uint8_t);
+static const uint32_t NODE_TYPE_OFFSET = 0;
+static const uint32_t IS_ROOT_SIZE = sizeof(uint8_t);
+static const uint32_t IS_ROOT_OFFSET = NODE_TYPE_SIZE;
+static const uint32_t PARENT_POINTER_SIZE = sizeof(uint32_t);
+static const uint32_t PARENT_POINTER_OFFSET = IS_ROOT_OFFSET + IS_ROOT_SIZE;
+static const uint8_t COMMON_NODE_HEADER_SIZE = NODE_TYPE_SIZE + IS_ROOT_SIZE + PARENT_POINTER_SIZE;
+
+/**
+ * 数据库头页布局
+ * magic: 文件标识，末尾的数字随页内布局的改变而增加，不同的文件一律拒绝打开:
+ *        1 定长行；2 叶子按变长行存放（slotted page）；3 叶子的键集中存放在单元格指针之前的键数组中
+ * root_page: 表根节点页号
+ * first_trunk: 空闲页链表第一个主干页，0 表示没有空闲页
+ * free_page_count: 空闲页总数
+ * index_roots: username、email 索引树的根页号，0 表示没有索引（旧文件这里都是 0）
+ * version: 头页格式版本，必须等于 DB_FORMAT_VERSION；更早的文件没有这一项（为 0），不能打开
+ * page_size: 页大小，建库时选定，之后不变
+ * page_count: 数据库的页数，追加新页时更新；打开时文件比它短，缺的页按新页处理（见 table_attach）
+ */
+static const char DB_HEADER_MAGIC[] = "mydb format 3";
+static const uint32_t HEADER_MAGIC_SIZE = 16;
+static const uint32_t HEADER_MAGIC_OFFSET = 0;
+static const uint32_t HEADER_ROOT_PAGE_OFFSET = HEADER_MAGIC_OFFSET + HEADER_MAGIC_SIZE;
+static const uint32_t HEADER_FIRST_TRUNK_OFFSET = HEADER_ROOT_PAGE_OFFSET + sizeof(uint32_t);
+static const uint32_t HEADER_FREE_PAGE_COUNT_OFFSET = HEADER_FIRST_TRUNK_OFFSET + sizeof(uint32_t);
+static const uint32_t HEADER_INDEX_ROOTS_OFFSET = HEADER_FREE_PAGE_COUNT_OFFSET + sizeof(uint32_t);
+static const uint32_t HEADER_VERSION_OFFSET = HEADER_INDEX_ROOTS_OFFSET + NUM_INDEXED_COLUMNS * sizeof(uint32_t);
+static const uint32_t HEADER_PAGE_SIZE_OFFSET = HEADER_VERSION_OFFSET + sizeof(uint32_t);
+static const uint32_t HEADER_PAGE_COUNT_OFFSET = HEADER_PAGE_SIZE_OFFSET + sizeof(uint32_t);
+
+/**
+ * 空闲页链表主干页布局
+ * 与 SQLite 相同，主干页记录下一个主干页和一组空闲叶子页号
+ */
+static const uint32_t FREELIST_TRUNK_NEXT_OFFSET = 0;
+static const uint32_t FREELIST_TRUNK_NUM_LEAVES_OFFSET = FREELIST_TRUNK_NEXT_OFFSET + sizeof(uint32_t);
+static const uint32_t FREELIST_TRUNK_LEAVES_OFFSET = FREELIST_TRUNK_NUM_LEAVES_OFFSET + sizeof(uint32_t);
+
+/**
+ * 内部节点头布局
+ */
+static const uint32_t INTERNAL_NODE_NUM_KEYS_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_NUM_KEYS_OFFSET = COMMON_NODE_HEADER_SIZE;
+static const uint32_t INTERNAL_NODE_RIGHT_CHILD_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_RIGHT_CHILD_OFFSET = INTERNAL_NODE_NUM_KEYS_OFFSET + INTERNAL_NODE_NUM_KEYS_SIZE;
+static const uint32_t INTERNAL_NODE_HEADER_SIZE = COMMON_NODE_HEADER_SIZE + INTERNAL_NODE_NUM_KEYS_SIZE + INTERNAL_NODE_RIGHT_CHILD_SIZE;
+
+/**
+ * 内部节点体布局
+ */
+static const uint32_t INTERNAL_NODE_KEY_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_CHILD_SIZE = sizeof(uint32_t);
+static const uint32_t INTERNAL_NODE_CELL_SIZE = INTERNAL_NODE_CHILD_SIZE + INTERNAL_NODE_KEY_SIZE;
+
+/**
+ * 叶子头节点布局
+ * content_start: 单元格内容区的起始偏移，内容区从页尾向前增长
+ * fragmented_bytes: 内容区中已不再使用、尚未整理回收的字节数
+ */
+static const uint32_t LEAF_NODE_NUM_CELLS_SIZE = sizeof(uint32_t);
+static const uint32_t LEAF_NODE_NUM_CELLS_OFFSET = COMMON_NODE_HEADER_SIZE;
+static const uint32_t LEAF_NODE_NEXT_LEAF_SIZE = sizeof(uint32_t);
+static const uint32_t LEAF_NODE_NEXT_LEAF_OFFSET = LEAF_NODE_NUM_CELLS_OFFSET + LEAF_NODE_NUM_CELLS_SIZE;
+static const uint32_t LEAF_NODE_CONTENT_START_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_CONTENT_START_OFFSET = LEAF_NODE_NEXT_LEAF_OFFSET + LEAF_NODE_NEXT_LEAF_SIZE;
+static const uint32_t LEAF_NODE_FRAGMENTED_BYTES_SIZE = sizeof(uint16_t);
+static const uint32_t LEAF_NODE_FRAGMENTED_BYTES_OFFSET = LEAF_NODE_CONTENT_START_OFFSET + LEAF_NODE_CONTENT_START_SIZE;
+static const uint32_t LEAF_NODE_HEADER_SIZE = LEAF_NODE_FRAGMENTED_BYTES_OFFSET + LEAF_NODE_FRAGMENTED_BYTES_SIZE;
+
+
+/**
+ * 行的序列化格式: id | 用户名长度(1 字节) | 用户名 | 邮箱长度(1 字节) | 邮箱
+ * 字符串只保存实际长度，不再补齐到列宽
+ */
+static const uint32_t ID_SIZE = sizeof_of_attribute(Row, id);              // ID大小
+static const uint32_t STRING_LENGTH_SIZE = sizeof(uint8_t);                // 字符串长度前缀大小
+static const uint32_t ROW_MIN_SIZE = ID_SIZE + 2 * STRING_LENGTH_SIZE;     // 最短的行
+static const uint32_t ROW_MAX_SIZE = ROW_MIN_SIZE + COLUMN_USERNAME_SIZE + COLUMN_EMAIL_SIZE; // 最长的行
+
+/**
+ * 索引项也按行的格式存放，索引树因此可以直接复用表的 B+ 树代码:
+ * id 的位置是列值的哈希（即键），用户名的位置是 4 字节的行 id，邮箱为空。
+ * 不同的值可能哈希相同，同一个值也可能出现在多行中，所以索引树的键可以重复
+ */
+static const uint32_t INDEX_ENTRY_ID_OFFSET = ID_SIZE + STRING_LENGTH_SIZE;
+static const uint32_t INDEX_ENTRY_SIZE = ROW_MIN_SIZE + sizeof(uint32_t);
+
+/**
+ * 叶子节点体布局（slotted page）
+ * 头部之后先是按顺序连续存放的键数组（4 字节对齐），紧接着是同样顺序的单元格指针数组，
+ * 每项是单元格在页内的偏移；单元格内容（序列化的行）从页尾向前存放。
+ * 页内查找只需扫描键数组，通常只碰一两条缓存行
+ */
+static const uint32_t LEAF_NODE_KEY_SIZE = sizeof(uint32_t);                                           // 键大小
+static const uint32_t LEAF_NODE_SLOT_SIZE = sizeof(uint16_t);                                          // 单元格指针大小
+static const uint32_t LEAF_NODE_ENTRY_SIZE = LEAF_NODE_KEY_SIZE + LEAF_NODE_SLOT_SIZE;                 // 每个单元格在两个数组中占用的大小
+static const uint32_t LEAF_NODE_KEYS_OFFSET = (LEAF_NODE_HEADER_SIZE + LEAF_NODE_KEY_SIZE - 1) / LEAF_NODE_KEY_SIZE * LEAF_NODE_KEY_SIZE; // 键数组偏移
+static const uint32_t LEAF_NODE_SEARCH_WINDOW = 32;                                                    // 二分查找缩小到这么多键后改为向量比较
+
+/**
+ * page_size_is_valid: 页大小必须是 MIN_PAGE_SIZE 到 MAX_PAGE_SIZE 之间的 2 的幂
+ */
+static bool page_size_is_valid(uint32_t page_size){
+    return page_size >= MIN_PAGE_SIZE && page_size <= MAX_PAGE_SIZE && (page_size & (page_size - 1)) == 0;
+}
+
+/**
+ * pager_layout_init: 按页大小设置分页器的页内布局，并分配重排节点用的临时空间
+ * 说明: 布局属于每个数据库，不同页大小的数据库可以同时打开
+ */
+static void pager_layout_init(Pager* pager, uint32_t page_size){
+    pager->page_size = page_size;
+    pager->leaf_node_space_for_cells = page_size - LEAF_NODE_KEYS_OFFSET;
+    pager->leaf_node_max_cells = pager->leaf_node_space_for_cells / (LEAF_NODE_ENTRY_SIZE + ROW_MIN_SIZE);
+    pager->internal_node_max_keys = (page_size - INTERNAL_NODE_HEADER_SIZE) / INTERNAL_NODE_CELL_SIZE;
+    pager->freelist_trunk_max_leaves = (page_size - FREELIST_TRUNK_LEAVES_OFFSET) / sizeof(uint32_t);
+
+    NodeScratch* scratch = &pager->scratch;
+    uint32_t max_cells = 2 * pager->leaf_node_max_cells + 1;
+    uint32_t max_children = 2 * (pager->internal_node_max_keys + 1);
+    scratch->pages = (uint8_t*)malloc(3 * (size_t)page_size);
+    scratch->defragment_page = scratch->pages + 2 * (size_t)page_size;
+    scratch->cells = (void**)malloc(max_cells * sizeof(void*));
+    scratch->sizes = (uint32_t*)malloc(max_cells * sizeof(uint32_t));
+    scratch->children = (uint32_t*)malloc(max_children * sizeof(uint32_t));
+    scratch->keys = (uint32_t*)malloc(max_children * sizeof(uint32_t));
+}
+
+/**
+ * pager_layout_free: 释放重排节点用的临时空间
+ */
+static void pager_layout_free(Pager* pager){
+    free(pager->scratch.pages);
+    free(pager->scratch.cells);
+    free(pager->scratch.sizes);
+    free(pager->scratch.children);
+    free(pager->scratch.keys);
+}
+
+static NodeType get_node_type(void* node){
+    uint8_t value = *((uint8_t*)(node + NODE_TYPE_OFFSET));
+    return (NodeType)value;
+}
+
+static void set_node_type(void* node, NodeType type){
+    uint8_t value = type;
+    *((uint8_t*)(node + NODE_TYPE_OFFSET)) = value;
+}
+
+static bool is_node_root(void* node){
+    uint8_t value = *((uint8_t*)(node + IS_ROOT_OFFSET));
+    return (bool)value;
+}
+
+static void set_node_root(void* node, bool is_root){
+    uint8_t value = is_root;
+    *((uint8_t*)(node + IS_ROOT_OFFSET)) = value;
+}
+
+// 获取父节点页号的地址
+// 父指针只有持有 writer_lock 的写者读写，读者下降和扫描时从不读取它
+static uint32_t* node_parent(void* node){
+    return node + PARENT_POINTER_OFFSET;
+}
+
+// 获取内部节点键个数的地址
+static uint32_t* internal_node_num_keys(void* node){
+    return node + INTERNAL_NODE_NUM_KEYS_OFFSET;
+}
+
+// 获取内部节点最右孩子页号的地址
+static uint32_t* internal_node_right_child(void* node){
+    return node + INTERNAL_NODE_RIGHT_CHILD_OFFSET;
+}
+
+// 获取内部节点第 cell_num 个单元格的地址
+static uint32_t* internal_node_cell(void* node, uint32_t cell_num){
+    return node + INTERNAL_NODE_HEADER_SIZE + cell_num * INTERNAL_NODE_CELL_SIZE;
+}
+
+// 获取内部节点第 child_num 个孩子页号的地址，child_num == num_keys 时为最右孩子
+static uint32_t* internal_node_child(void* node, uint32_t child_num){
+    uint32_t num_keys = *internal_node_num_keys(node);
+    if(child_num > num_keys){
+        db_fail("Tried to access child_num %d > num_keys %d", child_num, num_keys);
+    }
+    else if(child_num == num_keys){
+        return internal_node_right_child(node);
+    }
+    else{
+        return internal_node_cell(node, child_num);
+    }
+}
+
+// 获取内部节点第 key_num 个键的地址
+static uint32_t* internal_node_key(void* node, uint32_t key_num){
+    return (void*)internal_node_cell(node, key_num) + INTERNAL_NODE_CHILD_SIZE;
+}
+
+// 初始化node为内部节点
+static void initialize_internal_node(void* node){
+    set_node_type(node, NODE_INTERNAL);
+    set_node_root(node, false);
+    *internal_node_num_keys(node) = 0;
+}
+
+// 获取单元格个数 num_cells 的地址
+static uint32_t* leaf_node_num_cells(void* node){
+    return node + LEAF_NODE_NUM_CELLS_OFFSET;
+}
+
+// 获取右兄弟叶子页号的地址，0 表示没有右兄弟（页 0 是数据库头，不会是叶子）
+static uint32_t* leaf_node_next_leaf(void* node){
+    return node + LEAF_NODE_NEXT_LEAF_OFFSET;
+}
+
+/**
+ * 单元格内容区起始偏移存成 16 位；64KB 的页上内容区为空时的 65536 存为 0（与 SQLite 相同）
+ */
+static uint32_t leaf_node_content_start(void* node){
+    uint16_t value = *(uint16_t*)(node + LEAF_NODE_CONTENT_START_OFFSET);
+    return value == 0 ? 65536 : value;
+}
+
+static void set_leaf_node_content_start(void* node, uint32_t content_start){
+    *(uint16_t*)(node + LEAF_NODE_CONTENT_START_OFFSET) = (uint16_t)content_start;
+}
+
+// 获取碎片字节数的地址
+static uint16_t* leaf_node_fragmented_bytes(void* node){
+    return node + LEAF_NODE_FRAGMENTED_BYTES_OFFSET;
+}
+
+// 获取node单元格的key指针偏移，键在页首的键数组中
+static u_int32_t* leaf_node_key(void* node,uint32_t cell_num){
+    return node + LEAF_NODE_KEYS_OFFSET + cell_num * LEAF_NODE_KEY_SIZE;
+}
+
+// 获取第 cell_num 个单元格指针的地址，指针数组紧跟在键数组之后
+static uint16_t* leaf_node_slot(void* node, uint32_t cell_num){
+    return node + LEAF_NODE_KEYS_OFFSET + *leaf_node_num_cells(node) * LEAF_NODE_KEY_SIZE
+           + cell_num * LEAF_NODE_SLOT_SIZE;
+}
+
+// 获取node单元格的偏移地址
+static void* leaf_node_cell(void* node,uint32_t cell_num)
+{
+    return node + *leaf_node_slot(node, cell_num);
+}
+
+// 获取node单元格的value指针偏移，值就是整行（以键开头）
+static void* leaf_node_value(void* node,uint32_t cell_num){
+    return leaf_node_cell(node,cell_num);
+}
+
+// 初始化node为叶子节点
+static void initialize_leaf_node(Pager* pager, void* node){ 
+    set_node_type(node, NODE_LEAF);
+    set_node_root(node, false);
+    *leaf_node_num_cells(node) = 0;
+    *leaf_node_next_leaf(node) = 0;
+    set_leaf_node_content_start(node, pager->page_size);
+    *leaf_node_fragmented_bytes(node) = 0;
+ }
+
+/**
+ * stored_row_size: 已序列化的行占用的字节数
+ */
+uint32_t stored_row_size(void* source){
+    uint8_t username_length = *(uint8_t*)(source + ID_SIZE);
+    uint8_t email_length = *(uint8_t*)(source + ID_SIZE + STRING_LENGTH_SIZE + username_length);
+    return ROW_MIN_SIZE + username_length + email_length;
+}
+
+/**
+ * serialize_row: 将 source 结构序列化到 destination 指针指向的内存中
+ * 返回值: 写入的字节数
+ */
+static uint32_t serialize_row(Row* source, void* destination){
+    uint8_t username_length = strlen(source->username);
+    uint8_t email_length = strlen(source->email);
+    memcpy(destination, &(source->id), ID_SIZE);
+    destination += ID_SIZE;
+    *(uint8_t*)destination = username_length;
+    memcpy(destination + STRING_LENGTH_SIZE, source->username, username_length);
+    destination += STRING_LENGTH_SIZE + username_length;
+    *(uint8_t*)destination = email_length;
+    memcpy(destination + STRING_LENGTH_SIZE, source->email, email_length);
+    return ROW_MIN_SIZE + username_length + email_length;
+}
+
+/**
+ * leaf_node_free_space: 单元格指针数组与内容区之间连续的空闲字节数
+ */
+static uint32_t leaf_node_free_space(void* node){
+    return leaf_node_content_start(node) - LEAF_NODE_KEYS_OFFSET - *leaf_node_num_cells(node) * LEAF_NODE_ENTRY_SIZE;
+}
+
+/**
+ * leaf_node_defragment: 把单元格紧凑地重新排到页尾，回收碎片
+ */
+static void leaf_node_defragment(Pager* pager, void* node){
+    uint8_t* copy = pager->scratch.defragment_page;
+    memcpy(copy, node, pager->page_size);
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t content_start = pager->page_size;
+    for(uint32_t i = 0; i < num_cells; i++){
+        void* cell = leaf_node_cell(copy, i);
+        uint32_t size = stored_row_size(cell);
+        content_start -= size;
+        memcpy(node + content_start, cell, size);
+        *leaf_node_slot(node, i) = content_start;
+    }
+    set_leaf_node_content_start(node, content_start);
+    *leaf_node_fragmented_bytes(node) = 0;
+}
+
+/**
+ * leaf_node_insert_cell: 把已序列化的行插入到第 cell_num 个位置
+ * 返回值: 页内空间不足时返回 false，页不做任何修改
+ */
+static bool leaf_node_insert_cell(Pager* pager, void* node, uint32_t cell_num, void* cell, uint32_t cell_size){
+    uint32_t needed = cell_size + LEAF_NODE_ENTRY_SIZE;
+    if(leaf_node_free_space(node) < needed){
+        if(leaf_node_free_space(node) + *leaf_node_fragmented_bytes(node) < needed){
+            return false;
+        }
+        leaf_node_defragment(pager, node);
+    }
+
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t content_start = leaf_node_content_start(node) - cell_size;
+    memcpy(node + content_start, cell, cell_size);
+
+    // 键数组多一项，指针数组整体后移一个键的大小，插入点之后的指针再多移一项；
+    // 先移高处再移低处，避免覆盖。单元格内容原地不动
+    void* old_slots = leaf_node_slot(node, 0);
+    void* new_slots = old_slots + LEAF_NODE_KEY_SIZE;
+    memmove(new_slots + (cell_num + 1) * LEAF_NODE_SLOT_SIZE, old_slots + cell_num * LEAF_NODE_SLOT_SIZE,
+            (num_cells - cell_num) * LEAF_NODE_SLOT_SIZE);
+    memmove(new_slots, old_slots, cell_num * LEAF_NODE_SLOT_SIZE);
+    memmove(leaf_node_key(node, cell_num + 1), leaf_node_key(node, cell_num),
+            (num_cells - cell_num) * LEAF_NODE_KEY_SIZE);
+
+    // 行以 id 开头，id 就是键
+    memcpy(leaf_node_key(node, cell_num), cell, LEAF_NODE_KEY_SIZE);
+    *leaf_node_num_cells(node) = num_cells + 1;
+    *leaf_node_slot(node, cell_num) = content_start;
+    set_leaf_node_content_start(node, content_start);
+    return true;
+}
+
+/**
+ * leaf_node_delete_cell: 删除第 cell_num 个单元格
+ * 说明: 单元格内容留在原处记为碎片，恰好在内容区起点时直接把起点后移
+ */
+static void leaf_node_delete_cell(void* node, uint32_t cell_num){
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t offset = *leaf_node_slot(node, cell_num);
+    uint32_t size = stored_row_size(node + offset);
+    if(offset == leaf_node_content_start(node)){
+        set_leaf_node_content_start(node, offset + size);
+    }
+    else{
+        *leaf_node_fragmented_bytes(node) += size;
+    }
+
+    // 键数组少一项，指针数组整体前移一个键的大小，删除点之后的指针再多移一项；先移低处再移高处
+    void* old_slots = leaf_node_slot(node, 0);
+    void* new_slots = old_slots - LEAF_NODE_KEY_SIZE;
+    memmove(leaf_node_key(node, cell_num), leaf_node_key(node, cell_num + 1),
+            (num_cells - cell_num - 1) * LEAF_NODE_KEY_SIZE);
+    memmove(new_slots, old_slots, cell_num * LEAF_NODE_SLOT_SIZE);
+    memmove(new_slots + cell_num * LEAF_NODE_SLOT_SIZE, old_slots + (cell_num + 1) * LEAF_NODE_SLOT_SIZE,
+            (num_cells - cell_num - 1) * LEAF_NODE_SLOT_SIZE);
+    *leaf_node_num_cells(node) = num_cells - 1;
+}
+
+/**
+ * leaf_node_used_bytes: 单元格（连同键和指针）实际占用的字节数，不含碎片
+ */
+static uint32_t leaf_node_used_bytes(Pager* pager, void* node){
+    return pager->leaf_node_space_for_cells - leaf_node_free_space(node) - *leaf_node_fragmented_bytes(node);
+}
+
+/**
+ * pager_hash: 计算页号所在的哈希桶
+ */
+static uint32_t pager_hash(Pager* pager, uint32_t page_num){
+    return (page_num * 2654435761u) & pager->hash_mask;
+}
+
+/**
+ * pager_lookup: 在缓冲池中查找页号对应的帧
+ * 返回值: 帧下标，未命中返回 -1
+ */
+static int32_t pager_lookup(Pager* pager, uint32_t page_num){
+    int32_t frame_index = pager->hash_buckets[pager_hash(pager, page_num)];
+    while(frame_index != -1){
+        if(pager->frames[frame_index].page_num == page_num){
+            return frame_index;
+        }
+        frame_index = pager->frames[frame_index].hash_next;
+    }
+    return -1;
+}
+
+static void pager_hash_insert(Pager* pager, int32_t frame_index){
+    Frame* frame = &pager->frames[frame_index];
+    uint32_t bucket = pager_hash(pager, frame->page_num);
+    frame->hash_next = pager->hash_buckets[bucket];
+    pager->hash_buckets[bucket] = frame_index;
+}
+
+static void pager_hash_remove(Pager* pager, int32_t frame_index){
+    Frame* frame = &pager->frames[frame_index];
+    int32_t* link = &pager->hash_buckets[pager_hash(pager, frame->page_num)];
+    while(*link != frame_index){
+        link = &pager->frames[*link].hash_next;
+    }
+    *link = frame->hash_next;
+    frame->hash_next = -1;
+}
+
+/**
+ * pager_write_page: 将一页数据写入文件中 page_num 对应的位置
+ */
+static void pager_write_page(Pager* pager, uint32_t page_num, void* data){
+    ssize_t bytes_written = pwrite(pager->file_descriptor, data, pager->page_size, (off_t)page_num * pager->page_size);
+    if(bytes_written == -1){
+        db_fail("Error writing file: %d", errno);
+    }
+    pager->stats.pages_written++;
+    off_t end = ((off_t)page_num + 1) * pager->page_size;
+    if(end > pager->file_length){
+        pager->file_length = end;
+    }
+}
+
+/**
+ * write_fully: 用 pwritev 把 iov 全部写到文件的 offset 处，处理短写和 EINTR
+ */
+static void write_fully(int fd, struct iovec* iov, int iovcnt, off_t offset){
+    while(iovcnt > 0){
+        ssize_t bytes_written = pwritev(fd, iov, iovcnt, offset);
+        if(bytes_written == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            db_fail("Error writing file: %d", errno);
+        }
+        // 处理短写: 跳过已经写完的部分后继续
+        offset += bytes_written;
+        while(iovcnt > 0 && (size_t)bytes_written >= iov->iov_len){
+            bytes_written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(iovcnt > 0){
+            iov->iov_base += bytes_written;
+            iov->iov_len -= bytes_written;
+        }
+    }
+}
+
+/**
+ * pager_write_run: 用一次 pwritev 把页号连续的若干帧写入文件
+ * first_page_num: 第一帧对应的页号
+ * iov / iovcnt: 每个元素指向一帧，长度为页大小
+ */
+static void pager_write_run(Pager* pager, uint32_t first_page_num, struct iovec* iov, int iovcnt){
+    write_fully(pager->file_descriptor, iov, iovcnt, (off_t)first_page_num * pager->page_size);
+    pager->stats.pages_written += iovcnt;
+
+    off_t end = ((off_t)first_page_num + iovcnt) * pager->page_size;
+    if(end > pager->file_length){
+        pager->file_length = end;
+    }
+}
+
+/**
+ * wal_checksum: 以 checksum 为初值，对 num_words（偶数）个 32 位字做累积校验
+ */
+static void wal_checksum(const uint32_t* data, uint32_t num_words, uint32_t* checksum){
+    uint32_t s0 = checksum[0];
+    uint32_t s1 = checksum[1];
+    for(uint32_t i = 0; i < num_words; i += 2){
+        s0 += data[i] + s1;
+        s1 += data[i + 1] + s0;
+    }
+    checksum[0] = s0;
+    checksum[1] = s1;
+}
+
+static off_t wal_frame_offset(Wal* wal, uint32_t frame_num){
+    return WAL_HEADER_SIZE + (off_t)frame_num * (WAL_FRAME_HEADER_SIZE + wal->page_size);
+}
+
+static uint32_t wal_index_slot(Wal* wal, uint32_t page_num){
+    uint32_t mask = wal->index_capacity - 1;
+    uint32_t slot = (page_num * 2654435761u) & mask;
+    while(wal->index_pages[slot] != INVALID_PAGE_NUM && wal->index_pages[slot] != page_num){
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * wal_index_find: 查找日志中 page_num 的最新帧
+ * 返回值: 帧号，不在日志中时返回 WAL_NO_FRAME
+ */
+static uint32_t wal_index_find(Wal* wal, uint32_t page_num){
+    uint32_t slot = wal_index_slot(wal, page_num);
+    if(wal->index_pages[slot] == INVALID_PAGE_NUM){
+        return WAL_NO_FRAME;
+    }
+    return wal->index_frames[slot];
+}
+
+static void wal_index_clear(Wal* wal){
+    for(uint32_t i = 0; i < wal->index_capacity; i++){
+        wal->index_pages[i] = INVALID_PAGE_NUM;
+    }
+    wal->index_count = 0;
+}
+
+static void wal_index_put(Wal* wal, uint32_t page_num, uint32_t frame_num){
+    // 装载因子超过一半时扩容
+    if(2 * (wal->index_count + 1) > wal->index_capacity){
+        uint32_t old_capacity = wal->index_capacity;
+        uint32_t* old_pages = wal->index_pages;
+        uint32_t* old_frames = wal->index_frames;
+        wal->index_capacity = old_capacity * 2;
+        wal->index_pages = (uint32_t*)malloc(sizeof(uint32_t) * wal->index_capacity);
+        wal->index_frames = (uint32_t*)malloc(sizeof(uint32_t) * wal->index_capacity);
+        wal_index_clear(wal);
+        for(uint32_t i = 0; i < old_capacity; i++){
+            if(old_pages[i] != INVALID_PAGE_NUM){
+                uint32_t slot = wal_index_slot(wal, old_pages[i]);
+                wal->index_pages[slot] = old_pages[i];
+                wal->index_frames[slot] = old_frames[i];
+                wal->index_count++;
+            }
+        }
+        free(old_pages);
+        free(old_frames);
+    }
+
+    uint32_t slot = wal_index_slot(wal, page_num);
+    if(wal->index_pages[slot] == INVALID_PAGE_NUM){
+        wal->index_pages[slot] = page_num;
+        wal->index_count++;
+    }
+    wal->index_frames[slot] = frame_num;
+}
+
+/**
+ * wal_new_salt: 为新一代日志取一个盐值
+ * 说明: 优先取内核随机数；取不到时用时间、进程号和计数器拼出来，
+ *      保证同一进程中连续的两代日志盐值也不同
+ */
+static uint32_t wal_new_salt(void){
+    static uint32_t counter = 0;
+    uint32_t salt;
+    if(getrandom(&salt, sizeof(salt), GRND_NONBLOCK) == sizeof(salt)){
+        return salt;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint32_t sequence = __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+    return (uint32_t)now.tv_nsec ^ (uint32_t)now.tv_sec * 2654435761u ^ (uint32_t)getpid() << 16 ^ sequence * 40503u;
+}
+
+/**
+ * wal_write_header: 开始新一代日志，写入日志头并重置累积校验和
+ */
+static void wal_write_header(Wal* wal, uint32_t checkpoint_seq){
+    uint32_t header[WAL_HEADER_SIZE / sizeof(uint32_t)];
+    header[0] = WAL_MAGIC;
+    header[1] = WAL_VERSION;
+    header[2] = wal->page_size;
+    header[3] = checkpoint_seq;
+    header[4] = wal->salt[0];
+    header[5] = wal->salt[1];
+    wal->checksum[0] = 0;
+    wal->checksum[1] = 0;
+    wal_checksum(header, 6, wal->checksum);
+    header[6] = wal->checksum[0];
+    header[7] = wal->checksum[1];
+
+    struct iovec iov = {header, WAL_HEADER_SIZE};
+    write_fully(wal->file_descriptor, &iov, 1, 0);
+    wal->num_frames = 0;
+    wal->committed_frames = 0;
+}
+
+/**
+ * wal_append_frames: 把若干帧的页镜像追加到日志末尾并更新日志索引
+ * commit_db_size: 非零时最后一帧作为提交帧，记录提交后数据库的页数
+ */
+static void wal_append_frames(Pager* pager, Frame** frames, uint32_t count, uint32_t commit_db_size){
+    Wal* wal = pager->wal;
+    uint32_t frames_per_write = IOV_MAX / 2;
+    uint32_t* headers = (uint32_t*)malloc(WAL_FRAME_HEADER_SIZE * frames_per_write);
+    struct iovec* iov = (struct iovec*)malloc(sizeof(struct iovec) * 2 * frames_per_write);
+
+    for(uint32_t first = 0; first < count; first += frames_per_write){
+        uint32_t batch = count - first < frames_per_write ? count - first : frames_per_write;
+        for(uint32_t i = 0; i < batch; i++){
+            Frame* frame = frames[first + i];
+            uint32_t* header = headers + i * (WAL_FRAME_HEADER_SIZE / sizeof(uint32_t));
+            header[0] = frame->page_num;
+            header[1] = (first + i == count - 1) ? commit_db_size : 0;
+            header[2] = wal->salt[0];
+            header[3] = wal->salt[1];
+            wal_checksum(header, 2, wal->checksum);
+            wal_checksum(frame->data, pager->page_size / sizeof(uint32_t), wal->checksum);
+            header[4] = wal->checksum[0];
+            header[5] = wal->checksum[1];
+
+            iov[2 * i].iov_base = header;
+            iov[2 * i].iov_len = WAL_FRAME_HEADER_SIZE;
+            iov[2 * i + 1].iov_base = frame->data;
+            iov[2 * i + 1].iov_len = pager->page_size;
+            wal_index_put(wal, frame->page_num, wal->num_frames + i);
+        }
+        write_fully(wal->file_descriptor, iov, 2 * batch, wal_frame_offset(wal, wal->num_frames));
+        wal->num_frames += batch;
+        pager->stats.pages_written += batch;
+    }
+
+    free(iov);
+    free(headers);
+}
+
+/**
+ * wal_read_page: 如果日志中有 page_num 的镜像，把最新的一份读到 destination
+ * 返回值: 是否从日志中读到
+ */
+static bool wal_read_page(Pager* pager, uint32_t page_num, void* destination){
+    uint32_t frame_num = wal_index_find(pager->wal, page_num);
+    if(frame_num == WAL_NO_FRAME){
+        return false;
+    }
+    ssize_t bytes_read = pread(pager->wal->file_descriptor, destination, pager->page_size,
+                               wal_frame_offset(pager->wal, frame_num) + WAL_FRAME_HEADER_SIZE);
+    if(bytes_read != pager->page_size){
+        db_fail("Error reading wal: %d", errno);
+    }
+    pager->stats.pages_read++;
+    return true;
+}
+
+/**
+ * wal_sync: 让所有已写入的提交落盘，等待中的提交共享这一次 fdatasync
+ * 说明: fdatasync 时不持有缓冲池锁，先在锁内记下已写入的提交数，落盘后只把这些提交记为已同步；
+ *      同步期间其他连接追加的提交仍然等待下一次 fdatasync
+ */
+static void wal_sync(Pager* pager){
+    Wal* wal = pager->wal;
+    db_mutex_lock(&pager->mutex);
+    uint64_t commits = wal->commits;
+    bool synced = wal->synced_commits >= commits;
+    db_mutex_unlock(&pager->mutex);
+    if(synced){
+        return;
+    }
+    if(fdatasync(wal->file_descriptor) == -1){
+        db_fail("Error syncing wal: %d", errno);
+    }
+    db_mutex_lock(&pager->mutex);
+    pager->stats.syncs++;
+    // 同步期间检查点可能已经把更多提交记为已同步
+    if(wal->synced_commits < commits){
+        wal->synced_commits = commits;
+    }
+    db_mutex_unlock(&pager->mutex);
+}
+
+static int compare_uint32_pairs(const void* a, const void* b){
+    uint32_t key_a = ((const uint32_t*)a)[0];
+    uint32_t key_b = ((const uint32_t*)b)[0];
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+/**
+ * wal_checkpoint: 把日志中每页的最新已提交镜像写回数据库文件，然后清空日志
+ * 说明: 按页号排序后合并成 pwritev，数据库文件 fsync 之后才开始新一代日志
+ */
+void wal_checkpoint(Pager* pager){
+    Wal* wal = pager->wal;
+    db_mutex_lock(&pager->mutex);
+    if(wal->num_frames == 0){
+        db_mutex_unlock(&pager->mutex);
+        return;
+    }
+    // 写回数据库文件之前日志必须已经落盘
+    if(fdatasync(wal->file_descriptor) == -1){
+        db_fail("Error syncing wal: %d", errno);
+    }
+    pager->stats.syncs++;
+
+    // 取出 (页号, 帧号) 并按页号排序
+    uint32_t* entries = (uint32_t*)malloc(sizeof(uint32_t) * 2 * wal->index_count);
+    uint32_t num_entries = 0;
+    for(uint32_t i = 0; i < wal->index_capacity; i++){
+        if(wal->index_pages[i] != INVALID_PAGE_NUM){
+            entries[2 * num_entries] = wal->index_pages[i];
+            entries[2 * num_entries + 1] = wal->index_frames[i];
+            num_entries++;
+        }
+    }
+    qsort(entries, num_entries, 2 * sizeof(uint32_t), compare_uint32_pairs);
+
+    // 直接 I/O 要求缓冲区按页对齐
+    void* run_buffer;
+    if(posix_memalign(&run_buffer, pager->page_size, (size_t)IOV_MAX * pager->page_size) != 0){
+        db_fail("Out of memory.");
+    }
+    struct iovec iov[IOV_MAX];
+    uint32_t i = 0;
+    while(i < num_entries){
+        uint32_t first_page_num = entries[2 * i];
+        int iovcnt = 0;
+        while(i < num_entries && iovcnt < IOV_MAX && entries[2 * i] == first_page_num + iovcnt){
+            uint32_t page_num = entries[2 * i];
+            int32_t frame_index = pager_lookup(pager, page_num);
+            if(frame_index != -1 && !pager->frames[frame_index].dirty){
+                // 缓冲池中的干净页就是最新提交的镜像
+                iov[iovcnt].iov_base = pager->frames[frame_index].data;
+            }
+            else{
+                iov[iovcnt].iov_base = run_buffer + (size_t)iovcnt * pager->page_size;
+                wal_read_page(pager, page_num, iov[iovcnt].iov_base);
+            }
+            iov[iovcnt].iov_len = pager->page_size;
+            iovcnt++;
+            i++;
+        }
+        pager_write_run(pager, first_page_num, iov, iovcnt);
+    }
+    free(run_buffer);
+    free(entries);
+
+    if(fsync(pager->file_descriptor) == -1){
+        db_fail("Error syncing file: %d", errno);
+    }
+    pager->stats.syncs++;
+
+    // 换一组盐值开始新一代日志，旧帧即使残留也不会再被当作有效帧
+    if(ftruncate(wal->file_descriptor, 0) == -1){
+        db_fail("Error truncating wal: %d", errno);
+    }
+    wal->salt[0]++;
+    wal->salt[1] = wal_new_salt();
+    wal_write_header(wal, wal->salt[0]);
+    if(fdatasync(wal->file_descriptor) == -1){
+        db_fail("Error syncing wal: %d", errno);
+    }
+    pager->stats.syncs++;
+    wal_index_clear(wal);
+    // 日志中的提交都已写回数据库文件并落盘
+    wal->synced_commits = wal->commits;
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * wal_recover: 重放日志，只接受校验通过且以提交帧结尾的事务
+ * 返回值: 最后一个提交记录的数据库页数
+ */
+static uint32_t wal_recover(Wal* wal, off_t wal_length){
+    uint32_t header[WAL_HEADER_SIZE / sizeof(uint32_t)];
+    if(pread(wal->file_descriptor, header, WAL_HEADER_SIZE, 0) != WAL_HEADER_SIZE){
+        return 0;
+    }
+    uint32_t checksum[2] = {0, 0};
+    wal_checksum(header, 6, checksum);
+    if(header[0] != WAL_MAGIC || header[1] != WAL_VERSION || header[2] != wal->page_size
+       || checksum[0] != header[6] || checksum[1] != header[7]){
+        return 0;
+    }
+    wal->salt[0] = header[4];
+    wal->salt[1] = header[5];
+
+    uint32_t max_frames = (wal_length - WAL_HEADER_SIZE) / (WAL_FRAME_HEADER_SIZE + wal->page_size);
+    uint32_t* uncommitted = (uint32_t*)malloc(sizeof(uint32_t) * (max_frames + 1));
+    uint32_t num_uncommitted = 0;
+    uint32_t db_size = 0;
+    uint32_t committed_checksum[2] = {checksum[0], checksum[1]};
+    void* buffer = malloc(WAL_FRAME_HEADER_SIZE + wal->page_size);
+
+    for(uint32_t frame_num = 0; frame_num < max_frames; frame_num++){
+        if(pread(wal->file_descriptor, buffer, WAL_FRAME_HEADER_SIZE + wal->page_size, wal_frame_offset(wal, frame_num))
+           != WAL_FRAME_HEADER_SIZE + wal->page_size){
+            break;
+        }
+        uint32_t* frame_header = (uint32_t*)buffer;
+        if(frame_header[2] != wal->salt[0] || frame_header[3] != wal->salt[1]){
+            break;
+        }
+        wal_checksum(frame_header, 2, checksum);
+        wal_checksum(buffer + WAL_FRAME_HEADER_SIZE, wal->page_size / sizeof(uint32_t), checksum);
+        if(checksum[0] != frame_header[4] || checksum[1] != frame_header[5]){
+            break;
+        }
+
+        uncommitted[num_uncommitted++] = frame_header[0];
+        if(frame_header[1] != 0){
+            // 提交帧: 本事务的所有帧生效
+            uint32_t first_frame = frame_num + 1 - num_uncommitted;
+            for(uint32_t i = 0; i < num_uncommitted; i++){
+                wal_index_put(wal, uncommitted[i], first_frame + i);
+            }
+            num_uncommitted = 0;
+            db_size = frame_header[1];
+            wal->committed_frames = frame_num + 1;
+            committed_checksum[0] = checksum[0];
+            committed_checksum[1] = checksum[1];
+        }
+    }
+    free(buffer);
+    free(uncommitted);
+
+    // 最后一个提交之后的帧属于未完成的事务，丢弃
+    wal->num_frames = wal->committed_frames;
+    wal->checksum[0] = committed_checksum[0];
+    wal->checksum[1] = committed_checksum[1];
+    return db_size;
+}
+
+/**
+ * wal_open: 打开数据库旁的日志文件，存在已提交的帧时重放并立即检查点
+ */
+static void wal_open(Pager* pager, const char* db_filename, const PagerConfig* config){
+    Wal* wal = (Wal*)malloc(sizeof(Wal));
+    wal->filename = (char*)malloc(strlen(db_filename) + 5);
+    sprintf(wal->filename, "%s-wal", db_filename);
+    wal->file_descriptor = open(wal->filename, O_RDWR | O_CREAT, S_IWUSR | S_IRUSR);
+    if(wal->file_descriptor == -1){
+        db_fail("Error opening file %s: %s", wal->filename, strerror(errno));
+    }
+    wal->num_frames = 0;
+    wal->committed_frames = 0;
+    wal->commits = 0;
+    wal->synced_commits = 0;
+    wal->group_commit = config->wal_group_commit > 0 ? config->wal_group_commit : 1;
+    wal->checkpoint_frames = config->wal_checkpoint_frames;
+    wal->page_size = pager->page_size;
+    wal->index_capacity = 1024;
+    wal->index_pages = (uint32_t*)malloc(sizeof(uint32_t) * wal->index_capacity);
+    wal->index_frames = (uint32_t*)malloc(sizeof(uint32_t) * wal->index_capacity);
+    wal_index_clear(wal);
+    wal->salt[0] = 0;
+    wal->salt[1] = wal_new_salt();
+    pager->wal = wal;
+
+    off_t wal_length = lseek(wal->file_descriptor, 0, SEEK_END);
+    if(wal_length >= WAL_HEADER_SIZE){
+        uint32_t db_size = wal_recover(wal, wal_length);
+        if(db_size > pager->num_pages){
+            pager->num_pages = db_size;
+        }
+    }
+    if(wal->num_frames > 0){
+        wal_checkpoint(pager);
+    }
+    else{
+        // 截断和新日志头落盘之后才能追加帧，否则崩溃后可能留下旧长度里的残帧
+        if(ftruncate(wal->file_descriptor, 0) == -1){
+            db_fail("Error truncating wal: %d", errno);
+        }
+        wal_write_header(wal, 0);
+        if(fsync(wal->file_descriptor) == -1){
+            db_fail("Error syncing wal: %d", errno);
+        }
+        pager->stats.syncs++;
+    }
+}
+
+/**
+ * wal_close: 检查点后删除日志文件
+ */
+static void wal_close(Pager* pager){
+    Wal* wal = pager->wal;
+    wal_checkpoint(pager);
+    close(wal->file_descriptor);
+    unlink(wal->filename);
+    free(wal->index_pages);
+    free(wal->index_frames);
+    free(wal->filename);
+    free(wal);
+    pager->wal = NULL;
+}
+
+/**
+ * pager_evict: 用 CLOCK 算法挑选一个可淘汰的帧，脏页先写回磁盘
+ * 返回值: 空出来的帧下标
+ * 说明: 被钉住的帧跳过；引用位为 1 的帧清零后给第二次机会
+ */
+static int32_t pager_evict(Pager* pager){
+    for(uint32_t step = 0; step < 2 * pager->num_frames; step++){
+        int32_t frame_index = pager->clock_hand;
+        Frame* frame = &pager->frames[frame_index];
+        pager->clock_hand = (pager->clock_hand + 1) % pager->num_frames;
+
+        if(frame->page_num == INVALID_PAGE_NUM){
+            return frame_index;
+        }
+        if(frame->pin_count > 0){
+            continue;
+        }
+        if(frame->referenced){
+            frame->referenced = false;
+            continue;
+        }
+
+        if(frame->dirty){
+            if(pager->wal){
+                // 日志模式下脏页不能直接覆盖数据库文件，作为未提交帧溢出到日志中
+                wal_append_frames(pager, &frame, 1, 0);
+            }
+            else{
+                pager_write_page(pager, frame->page_num, frame->data);
+            }
+            frame->dirty = false;
+        }
+        pager_hash_remove(pager, frame_index);
+        frame->page_num = INVALID_PAGE_NUM;
+        return frame_index;
+    }
+
+    db_fail("Buffer pool exhausted: all %d frames are pinned.", pager->num_frames);
+}
+
+/**
+ * pager_mmap_grow: 保证文件和映射区都能容纳 page_num 页
+ * 说明: 文件按 MMAP_GROW_PAGES 为单位用 ftruncate 扩展，关闭时再截断到实际页数；
+ *      映射区不够大时翻倍重新映射，有页被钉住时只允许原地扩展
+ */
+static void pager_mmap_grow(Pager* pager, uint32_t page_num){
+    off_t needed = ((off_t)page_num + 1) * pager->page_size;
+    if(needed > pager->file_length){
+        off_t new_length = ((off_t)page_num + MMAP_GROW_PAGES) / MMAP_GROW_PAGES * MMAP_GROW_PAGES * pager->page_size;
+        if(ftruncate(pager->file_descriptor, new_length) == -1){
+            db_fail("Error extending file: %d", errno);
+        }
+        pager->file_length = new_length;
+    }
+
+    if((size_t)needed > pager->map_size){
+        size_t new_size = pager->map_size;
+        while(new_size < (size_t)needed){
+            new_size *= 2;
+        }
+        void* map = mremap(pager->map, pager->map_size, new_size, pager->map_pins > 0 ? 0 : MREMAP_MAYMOVE);
+        if(map == MAP_FAILED){
+            db_fail("Error remapping file: %d", errno);
+        }
+        pager->map = map;
+        pager->map_size = new_size;
+    }
+}
+
+/**
+ * pager_fetch: 把页载入缓冲池并钉住，调用方需持有缓冲池锁
+ * 返回值: 帧下标
+ */
+static int32_t pager_fetch(Pager* pager, uint32_t page_num){
+    // 检查该页是否已经在缓冲池中
+    int32_t frame_index = pager_lookup(pager, page_num);
+    if(frame_index == -1){
+        // 如果没有，则腾出一帧
+        frame_index = pager_evict(pager);
+        Frame* frame = &pager->frames[frame_index];
+        memset(frame->data, 0, pager->page_size);
+
+        // 计算文件中已经存在的页数
+        uint32_t num_pages = pager->file_length / pager->page_size;
+
+        // 如果文件长度不是页大小的整数倍，则还需要额外一页 
+        if(pager->file_length % pager->page_size != 0){
+            num_pages++;
+        }   
+
+        if(pager->wal && wal_read_page(pager, page_num, frame->data)){
+            // 日志中的镜像比数据库文件中的新
+        }
+        else if(page_num < num_pages && page_num < pager->num_pages){
+            // 文件尾部不属于数据库的页（见 table_attach）当作新页，不读入旧内容
+            ssize_t bytes_read = pread(pager->file_descriptor, frame->data, pager->page_size, (off_t)page_num * pager->page_size);
+            if(bytes_read == -1){
+                db_fail("Error reading file: %d", errno);
+            }
+            pager->stats.pages_read++;
+        }
+        
+        if(page_num >= pager->num_pages){
+            pager->num_pages = page_num + 1;
+        }
+
+        frame->page_num = page_num;
+        frame->dirty = false;
+        pager_hash_insert(pager, frame_index);
+        pager->stats.cache_misses++;
+    }
+    else{
+        pager->stats.cache_hits++;
+    }
+
+    Frame* frame = &pager->frames[frame_index];
+    frame->pin_count++;
+    frame->referenced = true;
+    return frame_index;
+}
+
+/**
+ * get_page: 获取指定页的页面指针，并将该页钉在缓冲池中
+ * pager: 分页器指针
+ * page_num: 页号
+ * 返回值: 页面指针，用完后需调用 unpin_page 释放
+ * 说明: 只钉住不加页锁，用于写者自己锁住的页以及单线程的维护操作（打印、批量加载、整理）
+ */
+void* get_page(Pager* pager, uint32_t page_num){
+    db_mutex_lock(&pager->mutex);
+    void* page;
+    // mmap 模式下直接返回映射区中的地址，由操作系统按需缺页载入
+    if(pager->use_mmap){
+        if(((off_t)page_num + 1) * pager->page_size > pager->file_length){
+            pager_mmap_grow(pager, page_num);
+        }
+        if(page_num >= pager->num_pages){
+            pager->num_pages = page_num + 1;
+        }
+        pager->map_pins++;
+        pager->stats.cache_hits++;
+        page = pager->map + (size_t)page_num * pager->page_size;
+    }
+    else{
+        page = pager->frames[pager_fetch(pager, page_num)].data;
+    }
+    db_mutex_unlock(&pager->mutex);
+    held_push(HELD_PIN, pager, page_num);
+    return page;
+}
+
+/**
+ * get_page_latched: 钉住页并加页锁
+ * 说明: 在缓冲池锁内钉住，放开缓冲池锁之后才等页锁，等锁时不会挡住其他线程访问缓冲池；
+ *      mmap 模式下没有帧，只钉住不加锁（mmap 模式不支持多个线程共享）
+ */
+void* get_page_latched(Pager* pager, uint32_t page_num, LatchMode mode){
+    if(pager->use_mmap){
+        return get_page(pager, page_num);
+    }
+    db_mutex_lock(&pager->mutex);
+    Frame* frame = &pager->frames[pager_fetch(pager, page_num)];
+    db_mutex_unlock(&pager->mutex);
+    held_push(HELD_PIN, pager, page_num);
+    if(mode == LATCH_SHARED){
+        pthread_rwlock_rdlock(&frame->latch);
+    }
+    else{
+        pthread_rwlock_wrlock(&frame->latch);
+    }
+    db_held[db_num_held - 1].kind = HELD_LATCH;
+    return frame->data;
+}
+
+/**
+ * release_page: 放开 get_page_latched 加的页锁并释放引用
+ */
+void release_page(Pager* pager, uint32_t page_num){
+    if(pager->use_mmap){
+        unpin_page(pager, page_num);
+        return;
+    }
+    held_remove(HELD_LATCH, pager, page_num);
+    db_mutex_lock(&pager->mutex);
+    int32_t frame_index = pager_lookup(pager, page_num);
+    if(frame_index == -1 || pager->frames[frame_index].pin_count == 0){
+        db_fail("Tried to release page %d that is not pinned.", page_num);
+    }
+    pthread_rwlock_unlock(&pager->frames[frame_index].latch);
+    pager->frames[frame_index].pin_count--;
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * pager_mark_dirty: 标记已钉住的页被修改过，刷新时需要写回
+ * 说明: 所有修改页内容的路径都必须在修改后调用
+ */
+void pager_mark_dirty(Pager* pager, uint32_t page_num){
+    // mmap 模式下修改直接落在共享映射上，由 msync 统一写回
+    if(pager->use_mmap){
+        return;
+    }
+    db_mutex_lock(&pager->mutex);
+    int32_t frame_index = pager_lookup(pager, page_num);
+    if(frame_index == -1){
+        db_fail("Tried to mark page %d dirty that is not in the pool.", page_num);
+    }
+    pager->frames[frame_index].dirty = true;
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * unpin_page: 释放 get_page 对该页的引用，引用计数归零后该页可被淘汰
+ */
+void unpin_page(Pager* pager, uint32_t page_num){
+    held_remove(HELD_PIN, pager, page_num);
+    db_mutex_lock(&pager->mutex);
+    if(pager->use_mmap){
+        pager->map_pins--;
+    }
+    else{
+        int32_t frame_index = pager_lookup(pager, page_num);
+        if(frame_index == -1 || pager->frames[frame_index].pin_count == 0){
+            db_fail("Tried to unpin page %d that is not pinned.", page_num);
+        }
+        pager->frames[frame_index].pin_count--;
+    }
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * deserialize_row: 将 Row 结构从 source 指针指向的内存中反序列化到 destination 指针指向的结构中
+ */
+void deserialize_row(void* source, Row* destination){
+    memcpy(&(destination->id), source, ID_SIZE);
+    source += ID_SIZE;
+    uint8_t username_length = *(uint8_t*)source;
+    memcpy(destination->username, source + STRING_LENGTH_SIZE, username_length);
+    destination->username[username_length] = '\0';
+    source += STRING_LENGTH_SIZE + username_length;
+    uint8_t email_length = *(uint8_t*)source;
+    memcpy(destination->email, source + STRING_LENGTH_SIZE, email_length);
+    destination->email[email_length] = '\0';
+}
+
+
+static int compare_frames_by_page_num(const void* a, const void* b){
+    uint32_t page_a = (*(Frame* const*)a)->page_num;
+    uint32_t page_b = (*(Frame* const*)b)->page_num;
+    return (page_a > page_b) - (page_a < page_b);
+}
+
+/**
+ * pager_flush_all: 把缓冲池中所有脏页写回文件
+ * 说明: 只写脏页，按页号排序后把相邻的页合并成一次 pwritev；
+ *      头页最后单独写，中途出错时文件中的头页记录的页数不会超过已经写出的页
+ */
+static void pager_flush_all(Pager* pager){
+    if(pager->use_mmap){
+        if(pager->num_pages > 0 && msync(pager->map, (size_t)pager->num_pages * pager->page_size, MS_SYNC) == -1){
+            db_fail("Error syncing file: %d", errno);
+        }
+        return;
+    }
+    db_mutex_lock(&pager->mutex);
+    Frame** dirty_frames = (Frame**)malloc(sizeof(Frame*) * pager->num_frames);
+    uint32_t num_dirty = 0;
+    for (uint32_t i = 0; i < pager->num_frames; i++)
+    {
+        Frame* frame = &pager->frames[i];
+        if(frame->page_num != INVALID_PAGE_NUM && frame->dirty){
+            dirty_frames[num_dirty++] = frame;
+        }
+    }
+    qsort(dirty_frames, num_dirty, sizeof(Frame*), compare_frames_by_page_num);
+
+    // 头页排在最前面，先跳过
+    bool header_dirty = num_dirty > 0 && dirty_frames[0]->page_num == HEADER_PAGE_NUM;
+    struct iovec iov[IOV_MAX];
+    uint32_t i = header_dirty ? 1 : 0;
+    while(i < num_dirty){
+        uint32_t first_page_num = dirty_frames[i]->page_num;
+        int iovcnt = 0;
+        while(i < num_dirty && iovcnt < IOV_MAX && dirty_frames[i]->page_num == first_page_num + iovcnt){
+            iov[iovcnt].iov_base = dirty_frames[i]->data;
+            iov[iovcnt].iov_len = pager->page_size;
+            dirty_frames[i]->dirty = false;
+            iovcnt++;
+            i++;
+        }
+        pager_write_run(pager, first_page_num, iov, iovcnt);
+    }
+    if(header_dirty){
+        pager_write_page(pager, HEADER_PAGE_NUM, dirty_frames[0]->data);
+        dirty_frames[0]->dirty = false;
+    }
+    free(dirty_frames);
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * pager_commit: 提交当前语句所做的修改
+ * 说明: 未启用日志时什么都不做；否则把所有脏页作为一个事务追加到日志，
+ *      每 wal_group_commit 个提交才 fdatasync 一次，日志过大时自动检查点
+ */
+void pager_commit(Pager* pager){
+    Wal* wal = pager->wal;
+    if(wal == NULL){
+        return;
+    }
+
+    db_mutex_lock(&pager->mutex);
+    Frame** dirty_frames = (Frame**)malloc(sizeof(Frame*) * (pager->num_frames + 1));
+    uint32_t num_dirty = 0;
+    for (uint32_t i = 0; i < pager->num_frames; i++)
+    {
+        Frame* frame = &pager->frames[i];
+        if(frame->page_num != INVALID_PAGE_NUM && frame->dirty){
+            dirty_frames[num_dirty++] = frame;
+        }
+    }
+    qsort(dirty_frames, num_dirty, sizeof(Frame*), compare_frames_by_page_num);
+
+    bool relogged_root = false;
+    if(num_dirty == 0){
+        if(wal->num_frames == wal->committed_frames){
+            free(dirty_frames);
+            db_mutex_unlock(&pager->mutex);
+            return;
+        }
+        // 修改都已溢出到日志中，再记录一次头页作为提交帧
+        get_page(pager, 0);
+        dirty_frames[num_dirty++] = &pager->frames[pager_lookup(pager, 0)];
+        relogged_root = true;
+    }
+
+    wal_append_frames(pager, dirty_frames, num_dirty, pager->num_pages);
+    for(uint32_t i = 0; i < num_dirty; i++){
+        dirty_frames[i]->dirty = false;
+    }
+    if(relogged_root){
+        unpin_page(pager, 0);
+    }
+    free(dirty_frames);
+
+    wal->committed_frames = wal->num_frames;
+    wal->commits++;
+    bool needs_sync = wal->commits - wal->synced_commits >= wal->group_commit;
+    bool needs_checkpoint = wal->num_frames >= wal->checkpoint_frames;
+    db_mutex_unlock(&pager->mutex);
+
+    // fdatasync 时不持有缓冲池锁，读者照常访问缓冲池
+    if(needs_sync){
+        wal_sync(pager);
+    }
+    if(needs_checkpoint){
+        wal_checkpoint(pager);
+    }
+}
+
+/**
+ * pager_sync: 让已提交的修改落盘，结束尚未凑满的组提交
+ */
+void pager_sync(Pager* pager){
+    if(pager->wal){
+        wal_sync(pager);
+    }
+}
+
+/**
+ * pager_has_unsynced_commits: 是否还有已提交但尚未 fdatasync 的修改
+ * 说明: 组提交中前面的提交要等凑满一组（或 pager_sync）才落盘
+ */
+bool pager_has_unsynced_commits(Pager* pager){
+    if(pager->wal == NULL){
+        return false;
+    }
+    db_mutex_lock(&pager->mutex);
+    bool unsynced = pager->wal->synced_commits < pager->wal->commits;
+    db_mutex_unlock(&pager->mutex);
+    return unsynced;
+}
+
+/**
+ * pager_checkpoint: 把已提交的修改全部写回数据库文件并落盘
+ * 说明: 日志模式下提交后做一次检查点；否则写回所有脏页后 fsync
+ */
+void pager_checkpoint(Pager* pager){
+    if(pager->wal){
+        pager_commit(pager);
+        wal_checkpoint(pager);
+        return;
+    }
+    db_mutex_lock(&pager->mutex);
+    pager_flush_all(pager);
+    if(!pager->use_mmap){
+        if(fsync(pager->file_descriptor) == -1){
+            db_fail("Error syncing file: %d", errno);
+        }
+        pager->stats.syncs++;
+    }
+    db_mutex_unlock(&pager->mutex);
+}
+
+/**
+ * pager_close: 把修改写回文件后关闭分页器
+ */
+void pager_close(Pager* pager){
+    // 将缓冲池中的脏页刷入磁盘，并释放帧内存；日志模式下提交后检查点
+    if(pager->wal){
+        pager_commit(pager);
+        wal_close(pager);
+    }
+    else{
+        pager_flush_all(pager);
+    }
+    if(pager->use_mmap){
+        munmap(pager->map, pager->map_size);
+        // 去掉按块扩展时多出来的尾部空页
+        if(ftruncate(pager->file_descriptor, (off_t)pager->num_pages * pager->page_size) == -1){
+            db_fail("Error truncating file: %d", errno);
+        }
+    }
+    for (uint32_t i = 0; i < pager->num_frames; i++)
+    {
+        pthread_rwlock_destroy(&pager->frames[i].latch);
+    }
+    if(pager->frame_arena != NULL){
+        munmap(pager->frame_arena, pager->frame_arena_size);
+    }
+    pthread_mutex_destroy(&pager->mutex);
+
+    int result = close(pager->file_descriptor);
+    if(result == -1){
+        db_fail("Error closing file: %d", errno);
+    }
+
+    free(pager->frames);
+    free(pager->hash_buckets);
+    free(pager->filename);
+    pager_layout_free(pager);
+    free(pager);
+}
+
+/**
+ * db_close: 关闭数据库
+ */
+static void table_free_indexes(Table* table);
+
+void db_close(Table* table){
+    // 整理时换文件失败，表上已经没有分页器
+    if(table->pager != NULL){
+        pager_close(table->pager);
+    }
+    table_free_indexes(table);
+    pthread_mutex_destroy(&table->writer_lock);
+    free(table);
+}
+
+
+/**
+ * cursor_close: 放开游标钉住的页，游标本身的存储由调用方管理
+ */
+void cursor_close(Cursor* cursor){
+    Pager* pager = cursor->table->pager;
+    release_page(pager, cursor->page_num);
+    for(uint32_t i = 0; i < cursor->num_ancestors; i++){
+        release_page(pager, cursor->ancestors[i]);
+    }
+    // 前移次数在关闭时一次累加，扫描时不必每行都去改共享的计数器
+    if(cursor->advances > 0){
+        STAT_ADD(cursor->table->stats.cursor_advances, cursor->advances);
+    }
+}
+
+static void indent(uint32_t level){
+    for(uint32_t i = 0; i < level; i++){
+        printf("  ");
+    }
+}
+
+/**
+ * print_tree: 递归打印以 page_num 为根的子树
+ */
+void print_tree(Pager* pager, uint32_t page_num, uint32_t indentation_level){
+    void* node = get_page(pager, page_num);
+    uint32_t num_keys, child;
+
+    switch(get_node_type(node)){
+        case NODE_LEAF:
+            num_keys = *leaf_node_num_cells(node);
+            indent(indentation_level);
+            printf("- leaf (size %d)\n", num_keys);
+            for(uint32_t i = 0; i < num_keys; i++){
+                indent(indentation_level + 1);
+                printf("- %d\n", *leaf_node_key(node, i));
+            }
+            break;
+        case NODE_INTERNAL:
+            num_keys = *internal_node_num_keys(node);
+            indent(indentation_level);
+            printf("- internal (size %d)\n", num_keys);
+            for(uint32_t i = 0; i < num_keys; i++){
+                child = *internal_node_child(node, i);
+                print_tree(pager, child, indentation_level + 1);
+
+                indent(indentation_level + 1);
+                printf("- key %d\n", *internal_node_key(node, i));
+            }
+            child = *internal_node_right_child(node);
+            print_tree(pager, child, indentation_level + 1);
+            break;
+    }
+    unpin_page(pager, page_num);
+}
+
+void print_constants(Pager* pager){
+    printf("PAGE_SIZE: %d\n", pager->page_size);
+    printf("ROW_MIN_SIZE: %d\n", ROW_MIN_SIZE);
+    printf("ROW_MAX_SIZE: %d\n", ROW_MAX_SIZE);
+    printf("COMMON_NODE_HEADER_SIZE: %d\n", COMMON_NODE_HEADER_SIZE);
+    printf("LEAF_NODE_HEADER_SIZE: %d\n", LEAF_NODE_HEADER_SIZE);
+    printf("LEAF_NODE_KEYS_OFFSET: %d\n", LEAF_NODE_KEYS_OFFSET);
+    printf("LEAF_NODE_SLOT_SIZE: %d\n", LEAF_NODE_SLOT_SIZE);
+    printf("LEAF_NODE_SPACE_FOR_CELLS: %d\n", pager->leaf_node_space_for_cells);
+    printf("LEAF_NODE_KEY_SIZE: %d\n", LEAF_NODE_KEY_SIZE);
+    printf("LEAF_NODE_MAX_CELLS: %d\n", pager->leaf_node_max_cells);
+    printf("INTERNAL_NODE_MAX_KEYS: %d\n", pager->internal_node_max_keys);
+}
+
+/**
+ * print_stats: 打印分页器、B+ 树和语句的计数器
+ */
+void print_stats(Table* table){
+    PagerStats* pager_stats = &table->pager->stats;
+    TableStats* stats = &table->stats;
+    uint64_t lookups = pager_stats->cache_hits + pager_stats->cache_misses;
+    printf("Pager:\n");
+    printf("  cache hits: %" PRIu64 "\n", pager_stats->cache_hits);
+    printf("  cache misses: %" PRIu64 "\n", pager_stats->cache_misses);
+    printf("  hit rate: %.2f%%\n", lookups > 0 ? 100.0 * pager_stats->cache_hits / lookups : 0.0);
+    printf("  pages read: %" PRIu64 " (%" PRIu64 " bytes)\n", pager_stats->pages_read,
+           pager_stats->pages_read * table->pager->page_size);
+    printf("  pages written: %" PRIu64 " (%" PRIu64 " bytes)\n", pager_stats->pages_written,
+           pager_stats->pages_written * table->pager->page_size);
+    printf("  syncs: %" PRIu64 "\n", pager_stats->syncs);
+    printf("B-tree:\n");
+    printf("  leaf splits: %" PRIu64 "\n", stats->leaf_splits);
+    printf("  internal splits: %" PRIu64 "\n", stats->internal_splits);
+    printf("  fast appends: %" PRIu64 "\n", stats->fast_appends);
+    printf("  merges: %" PRIu64 "\n", stats->merges);
+    printf("  borrows: %" PRIu64 "\n", stats->borrows);
+    printf("  cursors opened: %" PRIu64 "\n", stats->cursors_opened);
+    printf("  cursor advances: %" PRIu64 "\n", stats->cursor_advances);
+    printf("Statements:\n");
+    printf("  executed: %" PRIu64 "\n", stats->statements);
+    printf("  total time: %.6f s\n", stats->statement_ns / 1e9);
+    if(stats->statements > 0){
+        printf("  average time: %.3f us\n", stats->statement_ns / 1e3 / stats->statements);
+    }
+}
+
+void stats_reset(Table* table){
+    memset(&table->pager->stats, 0, sizeof(PagerStats));
+    memset(&table->stats, 0, sizeof(TableStats));
+}
+
+
+/**
+ * TokenType 词法单元类型
+ * TOKEN_WORD: 关键字、列名、数字或不带引号的值
+ * TOKEN_STRING: 单引号或双引号括起的字符串，不含引号本身
+ * TOKEN_COMMA / TOKEN_EQUAL: 逗号 / 等号
+ * TOKEN_END: 输入结束
+ * TOKEN_ERROR: 引号没有闭合
+ */
+typedef enum{
+    TOKEN_WORD,
+    TOKEN_STRING,
+    TOKEN_COMMA,
+    TOKEN_EQUAL,
+    TOKEN_END,
+    TOKEN_ERROR
+}TokenType;
+
+/**
+ * Token 词法单元，只记录在输入缓冲区中的位置，不做拷贝
+ */
+typedef struct{
+    TokenType type;
+    const char* start;
+    uint32_t length;
+}Token;
+
+/**
+ * Lexer 词法分析器
+ * position: 下一个待扫描的字符
+ */
+typedef struct{
+    const char* position;
+}Lexer;
+
+static void lexer_init(Lexer* lexer, const char* input){
+    lexer->position = input;
+}
+
+/**
+ * lexer_next: 扫描下一个词法单元
+ */
+static void lexer_next(Lexer* lexer, Token* token){
+    const char* p = lexer->position;
+    while(*p == ' ' || *p == '\t'){
+        p++;
+    }
+    token->start = p;
+    token->length = 0;
+    switch(*p){
+        case '\0':
+            token->type = TOKEN_END;
+            break;
+        case ',':
+            token->type = TOKEN_COMMA;
+            token->length = 1;
+            p++;
+            break;
+        case '=':
+            token->type = TOKEN_EQUAL;
+            token->length = 1;
+            p++;
+            break;
+        case '\'':
+        case '"':{
+            const char* end = strchr(p + 1, *p);
+            if(end == NULL){
+                token->type = TOKEN_ERROR;
+                p += strlen(p);
+                break;
+            }
+            token->type = TOKEN_STRING;
+            token->start = p + 1;
+            token->length = end - (p + 1);
+            p = end + 1;
+            break;
+        }
+        default:
+            token->type = TOKEN_WORD;
+            while(*p != '\0' && *p != ' ' && *p != '\t' && *p != ',' && *p != '='
+                  && *p != '\'' && *p != '"'){
+                p++;
+            }
+            token->length = p - token->start;
+            break;
+    }
+    lexer->position = p;
+}
+
+/**
+ * token_is: 判断词法单元是否是指定的单词
+ */
+static bool token_is(Token* token, const char* word){
+    return token->type == TOKEN_WORD && strncmp(token->start, word, token->length) == 0
+           && word[token->length] == '\0';
+}
+
+/**
+ * token_is_value: 判断词法单元能否作为字符串值
+ */
+static bool token_is_value(Token* token){
+    return token->type == TOKEN_WORD || token->type == TOKEN_STRING;
+}
+
+/**
+ * parse_id: 解析 id 常量，检查负数和 32 位溢出
+ */
+static PrepareResult parse_id(Token* token, uint32_t* id){
+    if(token->type != TOKEN_WORD){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    const char* p = token->start;
+    const char* end = token->start + token->length;
+    bool negative = p < end && *p == '-';
+    if(negative){
+        p++;
+    }
+    if(p == end){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    uint64_t value = 0;
+    for(; p < end; p++){
+        if(*p < '0' || *p > '9'){
+            return PREPARE_SYNTAX_ERROR;
+        }
+        value = value * 10 + (*p - '0');
+        if(value > UINT32_MAX){
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+    if(negative && value != 0){
+        return PREPARE_NEGATIVE_ID;
+    }
+    *id = value;
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * parse_column: 把列名解析为列编号
+ * 返回值: 不是列名时返回 false
+ */
+static bool parse_column(Token* token, Column* column){
+    if(token_is(token, "id")){
+        *column = COLUMN_ID;
+    }
+    else if(token_is(token, "username")){
+        *column = COLUMN_USERNAME;
+    }
+    else if(token_is(token, "email")){
+        *column = COLUMN_EMAIL;
+    }
+    else{
+        return false;
+    }
+    return true;
+}
+
+/**
+ * statement_set_insert_row: 把要插入的行直接写成序列化格式
+ * 说明: 调用方保证字符串长度不超过列宽
+ */
+void statement_set_insert_row(Statement* statement, uint32_t id, const char* username, uint32_t username_length,
+                              const char* email, uint32_t email_length){
+    statement->type = STATEMENT_INSERT;
+    statement->id_to_insert = id;
+    uint8_t* cell = statement->cell_to_insert;
+    memcpy(cell, &id, ID_SIZE);
+    cell += ID_SIZE;
+    *cell = username_length;
+    memcpy(cell + STRING_LENGTH_SIZE, username, username_length);
+    cell += STRING_LENGTH_SIZE + username_length;
+    *cell = email_length;
+    memcpy(cell + STRING_LENGTH_SIZE, email, email_length);
+    statement->cell_to_insert_size = ROW_MIN_SIZE + username_length + email_length;
+}
+
+/**
+ *  prepare_insert: 准备插入语句
+ *  语法: insert id username email，字符串可以用引号括起来以包含空格
+ *  说明: 用户名和邮箱直接从输入缓冲区拷贝到序列化后的行中
+ */
+static PrepareResult prepare_insert(Lexer* lexer, Statement* statement) {
+    statement->type = STATEMENT_INSERT;
+    Token id, username, email, end;
+    lexer_next(lexer, &id);
+    lexer_next(lexer, &username);
+    lexer_next(lexer, &email);
+    lexer_next(lexer, &end);
+    if(!token_is_value(&username) || !token_is_value(&email) || end.type != TOKEN_END){
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    uint32_t id_value;
+    PrepareResult result = parse_id(&id, &id_value);
+    if(result != PREPARE_SUCCESS){
+        return result;
+    }
+    if(username.length > COLUMN_USERNAME_SIZE || email.length > COLUMN_EMAIL_SIZE){
+        return PREPARE_STRING_TOO_LONG;
+    }
+    statement_set_insert_row(statement, id_value, username.start, username.length, email.start, email.length);
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * prepare_row: 把一行 "id username email" 解析到 row 中
+ * 说明: 词法和 id 检查与 insert 语句相同，供 .bulkload 逐行读文件时使用
+ */
+PrepareResult prepare_row(const char* input, Row* row){
+    Lexer lexer;
+    lexer_init(&lexer, input);
+    Token id, username, email, end;
+    lexer_next(&lexer, &id);
+    lexer_next(&lexer, &username);
+    lexer_next(&lexer, &email);
+    lexer_next(&lexer, &end);
+    if(!token_is_value(&username) || !token_is_value(&email) || end.type != TOKEN_END){
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    PrepareResult result = parse_id(&id, &row->id);
+    if(result != PREPARE_SUCCESS){
+        return result;
+    }
+    if(username.length > COLUMN_USERNAME_SIZE || email.length > COLUMN_EMAIL_SIZE){
+        return PREPARE_STRING_TOO_LONG;
+    }
+    memcpy(row->username, username.start, username.length);
+    row->username[username.length] = '\0';
+    memcpy(row->email, email.start, email.length);
+    row->email[email.length] = '\0';
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * prepare_where_id: 解析 id = N 或 id between A and B，与已有范围取交集
+ */
+static PrepareResult prepare_where_id(Lexer* lexer, Statement* statement){
+    Token op, token;
+    uint32_t start, end;
+    PrepareResult result;
+    lexer_next(lexer, &op);
+    if(op.type == TOKEN_EQUAL){
+        lexer_next(lexer, &token);
+        if((result = parse_id(&token, &start)) != PREPARE_SUCCESS){
+            return result;
+        }
+        end = start;
+    }
+    else if(token_is(&op, "between")){
+        lexer_next(lexer, &token);
+        if((result = parse_id(&token, &start)) != PREPARE_SUCCESS){
+            return result;
+        }
+        lexer_next(lexer, &token);
+        if(!token_is(&token, "and")){
+            return PREPARE_SYNTAX_ERROR;
+        }
+        lexer_next(lexer, &token);
+        if((result = parse_id(&token, &end)) != PREPARE_SUCCESS){
+            return result;
+        }
+    }
+    else{
+        return PREPARE_SYNTAX_ERROR;
+    }
+
+    if(statement->has_id_range){
+        start = start > statement->id_start ? start : statement->id_start;
+        end = end < statement->id_end ? end : statement->id_end;
+    }
+    statement->has_id_range = true;
+    statement->id_start = start;
+    statement->id_end = end;
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * prepare_where_string: 解析 username/email 上的 = value 或 like 'prefix%'
+ */
+static PrepareResult prepare_where_string(Lexer* lexer, Statement* statement, Column column){
+    Token op, value;
+    lexer_next(lexer, &op);
+    lexer_next(lexer, &value);
+    if(!token_is_value(&value) || statement->num_predicates == MAX_PREDICATES){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    Predicate* predicate = &statement->predicates[statement->num_predicates];
+    predicate->column = column;
+    uint32_t value_length = value.length;
+    if(op.type == TOKEN_EQUAL){
+        predicate->op = PREDICATE_EQUAL;
+    }
+    else if(token_is(&op, "like") && value_length > 0 && value.start[value_length - 1] == '%'){
+        // 只支持以 % 结尾的前缀匹配
+        predicate->op = PREDICATE_PREFIX;
+        value_length--;
+    }
+    else{
+        return PREPARE_SYNTAX_ERROR;
+    }
+    uint32_t max_length = column == COLUMN_USERNAME ? COLUMN_USERNAME_SIZE : COLUMN_EMAIL_SIZE;
+    if(value_length > max_length){
+        return PREPARE_STRING_TOO_LONG;
+    }
+    memcpy(predicate->value, value.start, value_length);
+    predicate->value[value_length] = '\0';
+    predicate->value_length = value_length;
+    statement->num_predicates++;
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * prepare_where: 解析 where 之后用 and 连接的条件，直到输入结束
+ */
+static PrepareResult prepare_where(Lexer* lexer, Statement* statement){
+    Token token;
+    while(true){
+        Column column;
+        lexer_next(lexer, &token);
+        if(!parse_column(&token, &column)){
+            return PREPARE_SYNTAX_ERROR;
+        }
+        PrepareResult result = column == COLUMN_ID ? prepare_where_id(lexer, statement)
+                                                   : prepare_where_string(lexer, statement, column);
+        if(result != PREPARE_SUCCESS){
+            return result;
+        }
+        lexer_next(lexer, &token);
+        if(token.type == TOKEN_END){
+            return PREPARE_SUCCESS;
+        }
+        if(!token_is(&token, "and")){
+            return PREPARE_SYNTAX_ERROR;
+        }
+    }
+}
+
+/**
+ * prepare_select: 准备查询语句
+ * 语法: select [* | 列名, ... | count(*)] [where 条件 [and 条件]...]
+ * 条件: id = N / id between A and B / username|email = 值 / username|email like '前缀%'
+ */
+static PrepareResult prepare_select(Lexer* lexer, Statement* statement) {
+    statement->type = STATEMENT_SELECT;
+    statement->has_id_range = false;
+    statement->num_projected = 0;
+    statement->num_predicates = 0;
+    statement->count_only = false;
+
+    Token token;
+    lexer_next(lexer, &token);
+    bool select_all = token.type == TOKEN_END || token_is(&token, "where");
+    while(token.type != TOKEN_END && !token_is(&token, "where")){
+        Column column;
+        if(token_is(&token, "*")){
+            select_all = true;
+        }
+        else if(token_is(&token, "count(*)") && statement->num_projected == 0 && !statement->count_only){
+            statement->count_only = true;
+        }
+        else if(parse_column(&token, &column) && statement->num_projected < MAX_PROJECTED_COLUMNS){
+            statement->projection[statement->num_projected++] = column;
+        }
+        else{
+            return PREPARE_SYNTAX_ERROR;
+        }
+        lexer_next(lexer, &token);
+        if(token.type == TOKEN_COMMA){
+            lexer_next(lexer, &token);
+        }
+    }
+    if(statement->count_only && (select_all || statement->num_projected > 0)){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    if(select_all){
+        if(statement->num_projected > 0){
+            return PREPARE_SYNTAX_ERROR;
+        }
+        statement->projection[0] = COLUMN_ID;
+        statement->projection[1] = COLUMN_USERNAME;
+        statement->projection[2] = COLUMN_EMAIL;
+        statement->num_projected = 3;
+    }
+    if(token.type == TOKEN_END){
+        return PREPARE_SUCCESS;
+    }
+    return prepare_where(lexer, statement);
+}
+
+/**
+ * prepare_delete: 准备删除语句
+ * 语法: delete where 条件 [and 条件]...，条件与 select 相同；必须带 where，避免误删整张表
+ */
+static PrepareResult prepare_delete(Lexer* lexer, Statement* statement){
+    statement->type = STATEMENT_DELETE;
+    statement->has_id_range = false;
+    statement->num_predicates = 0;
+
+    Token token;
+    lexer_next(lexer, &token);
+    if(!token_is(&token, "where")){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    return prepare_where(lexer, statement);
+}
+
+/**
+ * prepare_create_index: 准备建索引语句
+ * 语法: create index on username|email
+ */
+static PrepareResult prepare_create_index(Lexer* lexer, Statement* statement){
+    statement->type = STATEMENT_CREATE_INDEX;
+    Token index, on, column, end;
+    lexer_next(lexer, &index);
+    lexer_next(lexer, &on);
+    lexer_next(lexer, &column);
+    lexer_next(lexer, &end);
+    if(!token_is(&index, "index") || !token_is(&on, "on") || end.type != TOKEN_END
+       || !parse_column(&column, &statement->index_column) || statement->index_column == COLUMN_ID){
+        return PREPARE_SYNTAX_ERROR;
+    }
+    return PREPARE_SUCCESS;
+}
+
+/**
+ * prepare_statement: 准备语句
+ * 返回值: 准备结果
+ * 说明: 一遍扫描输入缓冲区，按第一个单词分派
+ */
+PrepareResult prepare_statement(const char* input, Statement* statement) {
+    Lexer lexer;
+    Token keyword;
+    lexer_init(&lexer, input);
+    lexer_next(&lexer, &keyword);
+    if(token_is(&keyword, "insert")){
+        return prepare_insert(&lexer, statement);
+    }
+
+    if(token_is(&keyword, "select")){
+        return prepare_select(&lexer, statement);
+    }
+
+    if(token_is(&keyword, "create")){
+        return prepare_create_index(&lexer, statement);
+    }
+
+    if(token_is(&keyword, "delete")){
+        return prepare_delete(&lexer, statement);
+    }
+
+    return PREPARE_UNRECOGNIZED_STATEMENT;
+}
+
+/**
+ * cursor_value: 游标所指的行在页中的地址
+ * 说明: 游标已经钉住并锁住了所在页，直接使用缓存的页指针
+ */
+void *cursor_value(Cursor* cursor){
+    return leaf_node_value(cursor->node, cursor->cell_num);  
+}
+
+/**
+ * cursor_skip_exhausted_leaves: 游标越过当前叶子末尾时，沿右兄弟指针进入下一个非空叶子
+ * 说明: 没有右兄弟时到达表尾
+ */
+static void cursor_skip_exhausted_leaves(Cursor* cursor){
+    Pager* pager = cursor->table->pager;
+    while(cursor->cell_num >= *leaf_node_num_cells(cursor->node)){
+        uint32_t next_page_num = *leaf_node_next_leaf(cursor->node);
+        if(next_page_num == 0){
+            cursor->end_of_table = true;
+            return;
+        }
+        /*
+            先锁住右兄弟再放开当前叶子。叶子之间总是从左到右加锁: 读者沿右兄弟指针前进，
+            写者在 btree_rebalance_child 中同时锁住相邻两个叶子时也先锁左边的；
+            写者自顶向下加锁，锁住叶子之后不会再等内部节点，所以这里等写者不会形成环
+        */
+        void* next_node = get_page_latched(pager, next_page_num, cursor->latch);
+        release_page(pager, cursor->page_num);
+        cursor->page_num = next_page_num;
+        cursor->node = next_node;
+        cursor->cell_num = 0;
+    }
+}
+
+/**
+ * 游标前移
+ * 说明: 该函数将游标指向下一行；当前叶子走完后沿右兄弟指针进入下一个叶子，
+ *      不再从根重新下降，没有右兄弟时到达表尾
+ */
+void cursor_advance(Cursor* cursor){
+    cursor->advances++;
+    cursor->cell_num += 1;
+    cursor_skip_exhausted_leaves(cursor);
+}
+
+// 头页字段访问
+static char* header_magic(void* header){
+    return header + HEADER_MAGIC_OFFSET;
+}
+
+static uint32_t* header_root_page(void* header){
+    return header + HEADER_ROOT_PAGE_OFFSET;
+}
+
+static uint32_t* header_first_trunk(void* header){
+    return header + HEADER_FIRST_TRUNK_OFFSET;
+}
+
+static uint32_t* header_free_page_count(void* header){
+    return header + HEADER_FREE_PAGE_COUNT_OFFSET;
+}
+
+static uint32_t* header_index_root(void* header, uint32_t index_num){
+    return header + HEADER_INDEX_ROOTS_OFFSET + index_num * sizeof(uint32_t);
+}
+
+static uint32_t* header_version(void* header){
+    return header + HEADER_VERSION_OFFSET;
+}
+
+static uint32_t* header_page_size(void* header){
+    return header + HEADER_PAGE_SIZE_OFFSET;
+}
+
+static uint32_t* header_page_count(void* header){
+    return header + HEADER_PAGE_COUNT_OFFSET;
+}
+
+// 空闲链表主干页字段访问
+static uint32_t* freelist_trunk_next(void* trunk){
+    return trunk + FREELIST_TRUNK_NEXT_OFFSET;
+}
+
+static uint32_t* freelist_trunk_num_leaves(void* trunk){
+    return trunk + FREELIST_TRUNK_NUM_LEAVES_OFFSET;
+}
+
+static uint32_t* freelist_trunk_leaf(void* trunk, uint32_t leaf_num){
+    return trunk + FREELIST_TRUNK_LEAVES_OFFSET + leaf_num * sizeof(uint32_t);
+}
+
+/**
+ * get_unused_page_num: 分配一个新页
+ * 说明: 优先从空闲链表中取: 主干页中还有叶子页号时取最后一个，
+ *      否则主干页本身被重用；链表为空时才追加到文件末尾
+ */
+static uint32_t get_unused_page_num(Pager* pager){
+    void* header = get_page(pager, HEADER_PAGE_NUM);
+    uint32_t trunk_page_num = *header_first_trunk(header);
+    if(trunk_page_num == 0){
+        *header_page_count(header) = pager->num_pages + 1;
+        pager_mark_dirty(pager, HEADER_PAGE_NUM);
+        unpin_page(pager, HEADER_PAGE_NUM);
+        return pager->num_pages;
+    }
+
+    uint32_t page_num;
+    void* trunk = get_page(pager, trunk_page_num);
+    uint32_t num_leaves = *freelist_trunk_num_leaves(trunk);
+    if(num_leaves > 0){
+        page_num = *freelist_trunk_leaf(trunk, num_leaves - 1);
+        *freelist_trunk_num_leaves(trunk) = num_leaves - 1;
+        pager_mark_dirty(pager, trunk_page_num);
+    }
+    else{
+        page_num = trunk_page_num;
+        *header_first_trunk(header) = *freelist_trunk_next(trunk);
+    }
+    *header_free_page_count(header) -= 1;
+    pager_mark_dirty(pager, HEADER_PAGE_NUM);
+    unpin_page(pager, trunk_page_num);
+    unpin_page(pager, HEADER_PAGE_NUM);
+    return page_num;
+}
+
+/**
+ * pager_free_page: 把不再使用的页放回空闲链表
+ * 说明: 第一个主干页还有空位时记为其叶子，否则该页成为新的第一个主干页
+ */
+static void pager_free_page(Pager* pager, uint32_t page_num){
+    void* header = get_page(pager, HEADER_PAGE_NUM);
+    uint32_t trunk_page_num = *header_first_trunk(header);
+    void* trunk = trunk_page_num != 0 ? get_page(pager, trunk_page_num) : NULL;
+
+    if(trunk != NULL && *freelist_trunk_num_leaves(trunk) < pager->freelist_trunk_max_leaves){
+        uint32_t num_leaves = *freelist_trunk_num_leaves(trunk);
+        *freelist_trunk_leaf(trunk, num_leaves) = page_num;
+        *freelist_trunk_num_leaves(trunk) = num_leaves + 1;
+        pager_mark_dirty(pager, trunk_page_num);
+    }
+    else{
+        void* new_trunk = get_page(pager, page_num);
+        memset(new_trunk, 0, pager->page_size);
+        *freelist_trunk_next(new_trunk) = trunk_page_num;
+        *freelist_trunk_num_leaves(new_trunk) = 0;
+        *header_first_trunk(header) = page_num;
+        pager_mark_dirty(pager, page_num);
+        unpin_page(pager, page_num);
+    }
+    if(trunk != NULL){
+        unpin_page(pager, trunk_page_num);
+    }
+    *header_free_page_count(header) += 1;
+    pager_mark_dirty(pager, HEADER_PAGE_NUM);
+    unpin_page(pager, HEADER_PAGE_NUM);
+}
+
+
+/**
+ * row_view_init: 在已序列化的行上建立视图
+ */
+void row_view_init(void* source, RowView* view){
+    memcpy(&view->id, source, ID_SIZE);
+    source += ID_SIZE;
+    view->username_length = *(uint8_t*)source;
+    view->username = source + STRING_LENGTH_SIZE;
+    source += STRING_LENGTH_SIZE + view->username_length;
+    view->email_length = *(uint8_t*)source;
+    view->email = source + STRING_LENGTH_SIZE;
+}
+
+/**
+ * predicate_matches: 直接在页中的字节上判断行是否满足条件
+ */
+static bool predicate_matches(Predicate* predicate, RowView* view){
+    const char* data = predicate->column == COLUMN_USERNAME ? view->username : view->email;
+    uint32_t length = predicate->column == COLUMN_USERNAME ? view->username_length : view->email_length;
+    if(predicate->op == PREDICATE_EQUAL && length != predicate->value_length){
+        return false;
+    }
+    if(length < predicate->value_length){
+        return false;
+    }
+    return memcmp(data, predicate->value, predicate->value_length) == 0;
+}
+
+/**
+ * print_row: 按投影顺序把行中选中的列打印到 out
+ */
+static void print_row(FILE* out, RowView* view, Column* projection, uint32_t num_projected){
+    putc('(', out);
+    for(uint32_t i = 0; i < num_projected; i++){
+        if(i > 0){
+            fputs(", ", out);
+        }
+        switch(projection[i]){
+            case COLUMN_ID:
+                fprintf(out, "%u", view->id);
+                break;
+            case COLUMN_USERNAME:
+                fprintf(out, "%.*s", (int)view->username_length, view->username);
+                break;
+            case COLUMN_EMAIL:
+                fprintf(out, "%.*s", (int)view->email_length, view->email);
+                break;
+        }
+    }
+    fputs(")\n", out);
+}
+
+/**
+ * get_node_max_key: 获取以 node 为根的子树中最大的键
+ * 说明: 内部节点的最右孩子没有对应的键，需要沿最右孩子一路向下
+ */
+static uint32_t get_node_max_key(Pager* pager, void* node){
+    if(get_node_type(node) == NODE_LEAF){
+        return *leaf_node_key(node, *leaf_node_num_cells(node) - 1);
+    }
+    uint32_t right_child_page_num = *internal_node_right_child(node);
+    void* right_child = get_page(pager, right_child_page_num);
+    uint32_t max_key = get_node_max_key(pager, right_child);
+    unpin_page(pager, right_child_page_num);
+    return max_key;
+}
+
+/**
+ * internal_node_find_child: 在内部节点中二分查找 key 应该落入的孩子下标
+ * 返回值: 第一个键 >= key 的下标，都小于 key 时返回 num_keys（最右孩子）
+ */
+static uint32_t internal_node_find_child(void* node, uint32_t key){
+    uint32_t num_keys = *internal_node_num_keys(node);
+
+    uint32_t min_index = 0;
+    uint32_t max_index = num_keys;
+    while(min_index != max_index){
+        uint32_t index = (min_index + max_index) / 2;
+        uint32_t key_to_right = *internal_node_key(node, index);
+        if(key_to_right >= key){
+            max_index = index;
+        }
+        else{
+            min_index = index + 1;
+        }
+    }
+    return min_index;
+}
+
+/**
+ * update_children_parent: 把内部节点 node 所有孩子的父指针改为 page_num
+ * 说明: 孩子只钉住不加锁。父指针是写者私有的字段（见 node_parent），同时锁着孩子的读者只读页中的其他字段；
+ *      孩子中可能有本写者已经锁住的页，再加写锁会等自己
+ */
+static void update_children_parent(Pager* pager, void* node, uint32_t page_num){
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for(uint32_t i = 0; i <= num_keys; i++){
+        uint32_t child_page_num = *internal_node_child(node, i);
+        void* child = get_page(pager, child_page_num);
+        *node_parent(child) = page_num;
+        pager_mark_dirty(pager, child_page_num);
+        unpin_page(pager, child_page_num);
+    }
+}
+
+/**
+ * create_new_root: 根节点分裂后创建新的根
+ * left_max: 分裂后旧根（新的左孩子）子树中的最大键
+ * 说明: 旧根的内容拷贝到新分配的左孩子中，根页号保持不变，
+ *      根页被重新初始化为拥有左右两个孩子的内部节点
+ */
+static void create_new_root(Table* table, uint32_t left_max, uint32_t right_child_page_num){
+    Pager* pager = table->pager;
+    void* root = get_page(pager, table->root_page_num);
+    void* right_child = get_page(pager, right_child_page_num);
+    uint32_t left_child_page_num = get_unused_page_num(pager);
+    void* left_child = get_page(pager, left_child_page_num);
+
+    memcpy(left_child, root, pager->page_size);
+    set_node_root(left_child, false);
+    if(get_node_type(left_child) == NODE_INTERNAL){
+        update_children_parent(pager, left_child, left_child_page_num);
+    }
+
+    initialize_internal_node(root);
+    set_node_root(root, true);
+    *internal_node_num_keys(root) = 1;
+    *internal_node_child(root, 0) = left_child_page_num;
+    *internal_node_key(root, 0) = left_max;
+    *internal_node_right_child(root) = right_child_page_num;
+    *node_parent(left_child) = table->root_page_num;
+    *node_parent(right_child) = table->root_page_num;
+
+    pager_mark_dirty(pager, left_child_page_num);
+    pager_mark_dirty(pager, right_child_page_num);
+    pager_mark_dirty(pager, table->root_page_num);
+    unpin_page(pager, left_child_page_num);
+    unpin_page(pager, right_child_page_num);
+    unpin_page(pager, table->root_page_num);
+}
+
+static void internal_node_insert_child(Table* table, uint32_t parent_page_num, uint32_t left_page_num, uint32_t left_max,
+                                uint32_t right_page_num, bool right_edge);
+
+/**
+ * internal_node_split_and_insert: 内部节点已满时，连同新孩子一起一分为二
+ * children / keys: 插入新孩子后的完整孩子序列及其最大键，共 num_children 项，最后一项的键无意义
+ * right_edge: 新孩子是树最右边的节点（递增的键在最右叶子末尾追加时）
+ * 说明: 左半部分留在原页，右半部分移到新页，再把新页插入上一层；根节点分裂时创建新的根。
+ *      在最右边分裂时新页接管最后两个孩子（一个键），原页留下其余孩子，顺序插入时内部节点接近满；
+ *      新页若只有新孩子就没有键，会被当作未满节点
+ */
+static void internal_node_split_and_insert(Table* table, uint32_t page_num, uint32_t* children, uint32_t* keys, uint32_t num_children,
+                                    bool right_edge){
+    Pager* pager = table->pager;
+    STAT_ADD(table->stats.internal_splits, 1);
+    void* old_node = get_page(pager, page_num);
+    uint32_t new_page_num = get_unused_page_num(pager);
+    void* new_node = get_page(pager, new_page_num);
+    initialize_internal_node(new_node);
+    *node_parent(new_node) = *node_parent(old_node);
+
+    uint32_t left_count = right_edge ? num_children - 2 : num_children / 2;
+    uint32_t right_count = num_children - left_count;
+
+    for(uint32_t i = 0; i + 1 < left_count; i++){
+        *internal_node_cell(old_node, i) = children[i];
+        *internal_node_key(old_node, i) = keys[i];
+    }
+    *internal_node_num_keys(old_node) = left_count - 1;
+    *internal_node_right_child(old_node) = children[left_count - 1];
+    uint32_t left_max = keys[left_count - 1];
+
+    for(uint32_t i = 0; i + 1 < right_count; i++){
+        *internal_node_cell(new_node, i) = children[left_count + i];
+        *internal_node_key(new_node, i) = keys[left_count + i];
+    }
+    *internal_node_num_keys(new_node) = right_count - 1;
+    *internal_node_right_child(new_node) = children[num_children - 1];
+    update_children_parent(pager, new_node, new_page_num);
+
+    bool old_is_root = is_node_root(old_node);
+    uint32_t parent_page_num = *node_parent(old_node);
+    pager_mark_dirty(pager, page_num);
+    pager_mark_dirty(pager, new_page_num);
+    unpin_page(pager, new_page_num);
+    unpin_page(pager, page_num);
+
+    if(old_is_root){
+        create_new_root(table, left_max, new_page_num);
+    }
+    else{
+        internal_node_insert_child(table, parent_page_num, page_num, left_max, new_page_num, right_edge);
+    }
+}
+
+/**
+ * internal_node_insert_child: 孩子 left 分裂出 right 后，把 right 插入父节点中 left 的右边
+ * left_max: 分裂后 left 子树中的最大键
+ * right_edge: right 是树最右边的节点，父节点需要分裂时按最右边的方式分裂
+ * 说明: right 接管 left 原来在父节点中的键，left 的键更新为 left_max；
+ *      调用前 right 的父指针应已指向 parent_page_num
+ */
+static void internal_node_insert_child(Table* table, uint32_t parent_page_num, uint32_t left_page_num, uint32_t left_max,
+                                uint32_t right_page_num, bool right_edge){
+    Pager* pager = table->pager;
+    void* parent = get_page(pager, parent_page_num);
+    uint32_t num_keys = *internal_node_num_keys(parent);
+    uint32_t index = internal_node_find_child(parent, left_max);
+    // 索引树中相同的键可能跨过几个孩子，left 在这些孩子之后
+    while(index < num_keys && *internal_node_child(parent, index) != left_page_num
+          && *internal_node_key(parent, index) == left_max){
+        index++;
+    }
+    if(*internal_node_child(parent, index) != left_page_num){
+        db_fail("Parent %d does not point to child %d.", parent_page_num, left_page_num);
+    }
+
+    if(num_keys < pager->internal_node_max_keys){
+        if(index == num_keys){
+            // left 是最右孩子: 追加一个单元格，right 成为新的最右孩子
+            *internal_node_cell(parent, num_keys) = left_page_num;
+            *internal_node_key(parent, num_keys) = left_max;
+            *internal_node_right_child(parent) = right_page_num;
+        }
+        else{
+            uint32_t old_key = *internal_node_key(parent, index);
+            memmove(internal_node_cell(parent, index + 2), internal_node_cell(parent, index + 1),
+                    (num_keys - index - 1) * INTERNAL_NODE_CELL_SIZE);
+            *internal_node_key(parent, index) = left_max;
+            *internal_node_cell(parent, index + 1) = right_page_num;
+            *internal_node_key(parent, index + 1) = old_key;
+        }
+        *internal_node_num_keys(parent) = num_keys + 1;
+        pager_mark_dirty(pager, parent_page_num);
+        unpin_page(pager, parent_page_num);
+        return;
+    }
+
+    // 父节点已满: 在分页器的临时数组中完成插入后再分裂
+    uint32_t* children = pager->scratch.children;
+    uint32_t* keys = pager->scratch.keys;
+    for(uint32_t i = 0; i < num_keys; i++){
+        children[i] = *internal_node_cell(parent, i);
+        keys[i] = *internal_node_key(parent, i);
+    }
+    children[num_keys] = *internal_node_right_child(parent);
+    keys[num_keys] = 0;
+    unpin_page(pager, parent_page_num);
+
+    for(uint32_t i = num_keys + 1; i > index + 1; i--){
+        children[i] = children[i - 1];
+        keys[i] = keys[i - 1];
+    }
+    children[index + 1] = right_page_num;
+    keys[index + 1] = keys[index];
+    keys[index] = left_max;
+
+    internal_node_split_and_insert(table, parent_page_num, children, keys, num_keys + 2, right_edge);
+}
+
+/**
+ * leaf_node_split_and_insert: 叶子放不下新行时分裂，新行插入分裂后的某一半
+ * 说明: 右半部分移到新分配的叶子，再把新叶子插入父节点；根分裂时创建新的根
+ */
+static void leaf_node_split_and_insert(Cursor* cursor, void* cell, uint32_t cell_size){
+    Pager* pager = cursor->table->pager;
+    STAT_ADD(cursor->table->stats.leaf_splits, 1);
+    void* old_node = get_page(pager, cursor->page_num);
+    uint32_t new_page_num = get_unused_page_num(pager);
+    void* new_node = get_page(pager, new_page_num);
+    initialize_leaf_node(pager, new_node);    
+
+    /*
+        行是变长的，按字节而不是按单元格数把所有旧行加上新行平分到
+        旧（左）节点和新（右）节点中。先把旧页复制到分页器的临时页中，再依次追加。
+    */
+    uint8_t* old_copy = pager->scratch.pages;
+    memcpy(old_copy, old_node, pager->page_size);
+    uint32_t old_num_cells = *leaf_node_num_cells(old_copy);
+    uint32_t total_cells = old_num_cells + 1;
+
+    void** cells = pager->scratch.cells;
+    uint32_t* sizes = pager->scratch.sizes;
+    uint32_t total_bytes = 0;
+    for(uint32_t i = 0; i < total_cells; i++){
+        if(i == cursor->cell_num){
+            cells[i] = cell;
+            sizes[i] = cell_size;
+        }
+        else{
+            cells[i] = leaf_node_cell(old_copy, i < cursor->cell_num ? i : i - 1);
+            sizes[i] = stored_row_size(cells[i]);
+        }
+        total_bytes += sizes[i] + LEAF_NODE_ENTRY_SIZE;
+    }
+
+    // 在最右叶子末尾追加（键递增）时旧行全部留在左边，新叶子只放新行，顺序插入的叶子因此都是满的；
+    // 否则左边至少一个、右边至少一个，左边的字节数刚好超过一半时切开
+    bool right_edge = cursor->cell_num == old_num_cells && *leaf_node_next_leaf(old_copy) == 0;
+    uint32_t left_count = 1;
+    if(right_edge){
+        left_count = total_cells - 1;
+    }
+    else{
+        uint32_t left_bytes = sizes[0] + LEAF_NODE_ENTRY_SIZE;
+        while(left_count < total_cells - 1 && left_bytes * 2 < total_bytes){
+            left_bytes += sizes[left_count] + LEAF_NODE_ENTRY_SIZE;
+            left_count++;
+        }
+    }
+
+    initialize_leaf_node(pager, old_node);
+    set_node_root(old_node, is_node_root(old_copy));
+    *node_parent(old_node) = *node_parent(old_copy);
+    for(uint32_t i = 0; i < total_cells; i++){
+        void* destination_node = i < left_count ? old_node : new_node;
+        uint32_t index_within_node = i < left_count ? i : i - left_count;
+        leaf_node_insert_cell(pager, destination_node, index_within_node, cells[i], sizes[i]);
+    }
+
+    *leaf_node_next_leaf(new_node) = *leaf_node_next_leaf(old_copy);
+    *leaf_node_next_leaf(old_node) = new_page_num;
+    if(*leaf_node_next_leaf(new_node) == 0){
+        // 最右叶子分裂后新叶子成为最右叶子
+        cursor->table->rightmost_leaf = new_page_num;
+    }
+
+    bool old_is_root = is_node_root(old_node);
+    uint32_t parent_page_num = *node_parent(old_node);
+    uint32_t left_max = get_node_max_key(pager, old_node);
+    *node_parent(new_node) = parent_page_num;
+    pager_mark_dirty(pager, new_page_num);
+    pager_mark_dirty(pager, cursor->page_num);
+    unpin_page(pager, new_page_num);
+    unpin_page(pager, cursor->page_num);
+    if(old_is_root){
+        create_new_root(cursor->table, left_max, new_page_num);
+    }
+    else{
+        internal_node_insert_child(cursor->table, parent_page_num, cursor->page_num, left_max, new_page_num, right_edge);
+    }
+}
+
+
+/**
+ * leaf_node_insert: 在游标位置插入已序列化的行
+ */
+static void leaf_node_insert(Cursor* cursor, void* cell, uint32_t cell_size){
+    if(!leaf_node_insert_cell(cursor->table->pager, cursor->node, cursor->cell_num, cell, cell_size)){
+        // 页内放不下这一行时分裂
+        leaf_node_split_and_insert(cursor, cell, cell_size);
+        return;
+    }
+    pager_mark_dirty(cursor->table->pager, cursor->page_num);
+}
+
+/**
+ * count_keys_less_scalar: 统计 keys 中小于 key 的个数
+ */
+static uint32_t count_keys_less_scalar(const uint32_t* keys, uint32_t num_keys, uint32_t key){
+    uint32_t count = 0;
+    for(uint32_t i = 0; i < num_keys; i++){
+        count += keys[i] < key;
+    }
+    return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+    SSE2/AVX2 只有有符号 32 位比较，两边都异或 0x80000000 后
+    有符号比较的结果就等于无符号比较的结果
+*/
+__attribute__((target("sse2")))
+static uint32_t count_keys_less_sse2(const uint32_t* keys, uint32_t num_keys, uint32_t key){
+    const __m128i bias = _mm_set1_epi32(0x80000000);
+    const __m128i target = _mm_xor_si128(_mm_set1_epi32(key), bias);
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for(; i + 4 <= num_keys; i += 4){
+        __m128i chunk = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(keys + i)), bias);
+        uint32_t mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(chunk, target)));
+        count += __builtin_popcount(mask);
+    }
+    return count + count_keys_less_scalar(keys + i, num_keys - i, key);
+}
+
+__attribute__((target("avx2")))
+static uint32_t count_keys_less_avx2(const uint32_t* keys, uint32_t num_keys, uint32_t key){
+    const __m256i bias = _mm256_set1_epi32(0x80000000);
+    const __m256i target = _mm256_xor_si256(_mm256_set1_epi32(key), bias);
+    uint32_t count = 0;
+    uint32_t i = 0;
+    for(; i + 8 <= num_keys; i += 8){
+        __m256i chunk = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(keys + i)), bias);
+        uint32_t mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(target, chunk)));
+        count += __builtin_popcount(mask);
+    }
+    return count + count_keys_less_scalar(keys + i, num_keys - i, key);
+}
+#endif
+
+/**
+ * leaf_node_search_keys: 在有序键数组中找第一个不小于 key 的位置
+ * 说明: 先二分把范围缩小到 LEAF_NODE_SEARCH_WINDOW 个键以内，
+ *      再用向量比较一次数出窗口中小于 key 的键数；运行时按 CPU 选择 AVX2/SSE2/标量
+ */
+static uint32_t leaf_node_search_keys(const uint32_t* keys, uint32_t num_keys, uint32_t key){
+    uint32_t min_index = 0;
+    uint32_t one_past_max_index = num_keys;
+    while(one_past_max_index - min_index > LEAF_NODE_SEARCH_WINDOW){
+        uint32_t index = (min_index + one_past_max_index) / 2;
+        if(keys[index] < key){
+            min_index = index + 1;
+        }
+        else{
+            one_past_max_index = index;
+        }
+    }
+    const uint32_t* window = keys + min_index;
+    uint32_t window_size = one_past_max_index - min_index;
+#if defined(__x86_64__) || defined(__i386__)
+    if(__builtin_cpu_supports("avx2")){
+        return min_index + count_keys_less_avx2(window, window_size, key);
+    }
+    if(__builtin_cpu_supports("sse2")){
+        return min_index + count_keys_less_sse2(window, window_size, key);
+    }
+#endif
+    return min_index + count_keys_less_scalar(window, window_size, key);
+}
+
+/**
+ * leaf_node_find: 在已经钉住并锁住的叶子中查找 key，把 cursor 初始化为持有该叶子的游标
+ */
+static void leaf_node_find(Table* table, uint32_t page_num, void* node, LatchMode latch, uint32_t key, Cursor* cursor){
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    cursor->table = table;
+    cursor->page_num = page_num;
+    cursor->end_of_table = false;
+    cursor->node = node;
+    cursor->latch = latch;
+    cursor->num_ancestors = 0;
+    cursor->advances = 0;
+    STAT_ADD(table->stats.cursors_opened, 1);
+
+    // 在键数组中查找，返回的游标继续钉住该页
+    cursor->cell_num = leaf_node_search_keys(leaf_node_key(node, 0), num_cells, key);
+}
+
+/**
+ * table_find_latched: 从根开始查找 key，路径上每一页都加 latch 模式的锁
+ * 说明: 在每一层内部节点上二分查找孩子，直到叶子节点；
+ *      先锁住孩子再放开父节点（latch crabbing），任何时刻最多锁两页
+ */
+static void table_find_latched(Table* table, uint32_t key, LatchMode latch, Cursor* cursor){
+    Pager* pager = table->pager;
+    uint32_t page_num = table->root_page_num;
+    void* node = get_page_latched(pager, page_num, latch);
+    while(get_node_type(node) == NODE_INTERNAL){
+        uint32_t child_page_num = *internal_node_child(node, internal_node_find_child(node, key));
+        void* child = get_page_latched(pager, child_page_num, latch);
+        release_page(pager, page_num);
+        page_num = child_page_num;
+        node = child;
+    }
+    leaf_node_find(table, page_num, node, latch, key, cursor);
+}
+
+/**
+ * table_find: 从根开始查找 key（读者）
+ * cursor: 由调用方提供（通常在栈上），返回时指向 key 所在位置（或应插入位置），持有叶子的读锁
+ */
+void table_find(Table* table, uint32_t key, Cursor* cursor){
+    table_find_latched(table, key, LATCH_SHARED, cursor);
+}
+
+/**
+ * node_is_safe: 再插入一项（叶子中一行 / 内部节点中一个孩子）后节点不会分裂
+ */
+static bool node_is_safe(Pager* pager, void* node, uint32_t cell_size){
+    if(get_node_type(node) == NODE_LEAF){
+        return leaf_node_free_space(node) + *leaf_node_fragmented_bytes(node) >= cell_size + LEAF_NODE_ENTRY_SIZE;
+    }
+    return *internal_node_num_keys(node) < pager->internal_node_max_keys;
+}
+
+/**
+ * table_find_for_insert: 为插入 key 定位叶子（写者）
+ * cell_size: 要插入的行的大小，用来判断节点是否安全
+ * cursor: 返回时持有叶子写锁，分裂可能波及的祖先也仍然锁着
+ * 说明: 自顶向下逐层加写锁；孩子安全时分裂不会传到它上面，立即放开所有祖先。
+ *      分裂只修改这些锁住的页、新分配的页以及孩子的父指针（读者从不读取父指针）
+ */
+static void table_find_for_insert(Table* table, uint32_t key, uint32_t cell_size, Cursor* cursor){
+    Pager* pager = table->pager;
+    uint32_t ancestors[MAX_TREE_DEPTH];
+    uint32_t num_ancestors = 0;
+    uint32_t page_num = table->root_page_num;
+    void* node = get_page_latched(pager, page_num, LATCH_EXCLUSIVE);
+    while(get_node_type(node) == NODE_INTERNAL){
+        if(num_ancestors == MAX_TREE_DEPTH){
+            db_fail("Tree is deeper than %d levels.", MAX_TREE_DEPTH);
+        }
+        ancestors[num_ancestors++] = page_num;
+        page_num = *internal_node_child(node, internal_node_find_child(node, key));
+        node = get_page_latched(pager, page_num, LATCH_EXCLUSIVE);
+        if(node_is_safe(pager, node, cell_size)){
+            for(uint32_t i = 0; i < num_ancestors; i++){
+                release_page(pager, ancestors[i]);
+            }
+            num_ancestors = 0;
+        }
+    }
+    leaf_node_find(table, page_num, node, LATCH_EXCLUSIVE, key, cursor);
+    memcpy(cursor->ancestors, ancestors, num_ancestors * sizeof(uint32_t));
+    cursor->num_ancestors = num_ancestors;
+}
+
+/**
+ * table_find_for_append: 键比表中所有键都大时，不从根下降，直接定位到缓存的最右叶子末尾
+ * 返回值: 没有缓存、键不是最大或者叶子放不下这一行（需要分裂）时返回 false，此时不持有任何页
+ * 说明: 调用方持有 writer_lock。最右叶子是每个祖先的最右孩子，祖先中没有它的键，
+ *      不分裂的追加不会修改任何祖先，所以只锁叶子就够了
+ */
+static bool table_find_for_append(Table* table, uint32_t key, uint32_t cell_size, Cursor* cursor){
+    uint32_t page_num = table->rightmost_leaf;
+    if(page_num == INVALID_PAGE_NUM){
+        return false;
+    }
+    Pager* pager = table->pager;
+    void* node = get_page_latched(pager, page_num, LATCH_EXCLUSIVE);
+    if(get_node_type(node) != NODE_LEAF || *leaf_node_next_leaf(node) != 0){
+        // 缓存已经失效
+        release_page(pager, page_num);
+        table->rightmost_leaf = INVALID_PAGE_NUM;
+        return false;
+    }
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    if(num_cells == 0 || *leaf_node_key(node, num_cells - 1) >= key || !node_is_safe(pager, node, cell_size)){
+        release_page(pager, page_num);
+        return false;
+    }
+    leaf_node_find(table, page_num, node, LATCH_EXCLUSIVE, key, cursor);
+    STAT_ADD(table->stats.fast_appends, 1);
+    return true;
+}
+
+/**
+ * table_seek: 把 cursor 定位到第一个不小于 key 的行
+ * 说明: key 大于所在叶子中所有键时，游标顺着右兄弟指针移到下一个叶子的开头
+ */
+void table_seek(Table* table, uint32_t key, Cursor* cursor){
+    table_find(table, key, cursor);
+    cursor_skip_exhausted_leaves(cursor);
+}
+
+/**
+ * 获取表开始游标
+ * 说明: 把 cursor 定位到表中第一行
+ */
+void table_start(Table* table, Cursor* cursor){
+    // 键 0 一定落在最左边的叶子上；删除后最左叶子可能是空的，要顺着右兄弟指针往后找
+    table_seek(table, 0, cursor);
+}
+
+/**
+ * node_is_underfull: 删除后节点是否过空，需要与兄弟合并或从兄弟借
+ * 说明: 叶子按字节数，内部节点按孩子数；只剩一个孩子的内部节点总是过空
+ */
+static bool node_is_underfull(Pager* pager, void* node){
+    if(get_node_type(node) == NODE_LEAF){
+        return leaf_node_used_bytes(pager, node) * 100 < pager->leaf_node_space_for_cells * NODE_MIN_FILL_PERCENT;
+    }
+    uint32_t num_keys = *internal_node_num_keys(node);
+    return num_keys == 0 || (num_keys + 1) * 100 < (pager->internal_node_max_keys + 1) * NODE_MIN_FILL_PERCENT;
+}
+
+/**
+ * internal_node_read_children: 把内部节点的孩子和键读到数组中
+ * 返回值: 孩子数；最右孩子的键无意义，置为 0
+ */
+static uint32_t internal_node_read_children(void* node, uint32_t* children, uint32_t* keys){
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for(uint32_t i = 0; i < num_keys; i++){
+        children[i] = *internal_node_cell(node, i);
+        keys[i] = *internal_node_key(node, i);
+    }
+    children[num_keys] = *internal_node_right_child(node);
+    keys[num_keys] = 0;
+    return num_keys + 1;
+}
+
+/**
+ * internal_node_write_children: 用数组中的 num_children 个孩子重写内部节点，最后一个成为最右孩子
+ */
+static void internal_node_write_children(void* node, uint32_t* children, uint32_t* keys, uint32_t num_children){
+    for(uint32_t i = 0; i + 1 < num_children; i++){
+        *internal_node_cell(node, i) = children[i];
+        *internal_node_key(node, i) = keys[i];
+    }
+    *internal_node_num_keys(node) = num_children - 1;
+    *internal_node_right_child(node) = children[num_children - 1];
+}
+
+/**
+ * set_children_parent: 把 children[from, to) 的父指针改为 page_num
+ * 说明: 与 update_children_parent 一样只钉住孩子，不加页锁
+ */
+static void set_children_parent(Pager* pager, uint32_t* children, uint32_t from, uint32_t to, uint32_t page_num){
+    for(uint32_t i = from; i < to; i++){
+        void* child = get_page(pager, children[i]);
+        *node_parent(child) = page_num;
+        pager_mark_dirty(pager, children[i]);
+        unpin_page(pager, children[i]);
+    }
+}
+
+/**
+ * internal_node_remove_child: 孩子 index 并入左边的孩子 index - 1 后，把它从父节点中删除
+ * 说明: 左边的孩子接管它的键；删除的是最右孩子时左边的孩子成为最右孩子
+ */
+static void internal_node_remove_child(void* node, uint32_t index){
+    uint32_t num_keys = *internal_node_num_keys(node);
+    if(index == num_keys){
+        *internal_node_right_child(node) = *internal_node_cell(node, index - 1);
+    }
+    else{
+        *internal_node_key(node, index - 1) = *internal_node_key(node, index);
+        memmove(internal_node_cell(node, index), internal_node_cell(node, index + 1),
+                (num_keys - index - 1) * INTERNAL_NODE_CELL_SIZE);
+    }
+    *internal_node_num_keys(node) = num_keys - 1;
+}
+
+/**
+ * leaf_nodes_rebalance: 父节点中相邻的叶子 left、right 放得下时合并到 left，否则按字节数重新平分
+ * left_index: left 在父节点中的下标
+ * 返回值: 是否合并；合并后 right 已从父节点和叶子链表中摘下，由调用方释放
+ */
+static bool leaf_nodes_rebalance(Pager* pager, void* parent, uint32_t left_index, void* left, void* right){
+    uint8_t* left_copy = pager->scratch.pages;
+    uint8_t* right_copy = pager->scratch.pages + pager->page_size;
+    memcpy(left_copy, left, pager->page_size);
+    memcpy(right_copy, right, pager->page_size);
+    uint32_t left_cells = *leaf_node_num_cells(left_copy);
+    uint32_t total_cells = left_cells + *leaf_node_num_cells(right_copy);
+
+    void** cells = pager->scratch.cells;
+    uint32_t* sizes = pager->scratch.sizes;
+    uint32_t total_bytes = 0;
+    for(uint32_t i = 0; i < total_cells; i++){
+        cells[i] = i < left_cells ? leaf_node_cell(left_copy, i) : leaf_node_cell(right_copy, i - left_cells);
+        sizes[i] = stored_row_size(cells[i]);
+        total_bytes += sizes[i] + LEAF_NODE_ENTRY_SIZE;
+    }
+
+    bool merge = total_bytes <= pager->leaf_node_space_for_cells;
+    uint32_t left_count = total_cells;
+    if(!merge){
+        // 与分裂相同: 左边的字节数刚好超过一半时切开
+        uint32_t left_bytes = sizes[0] + LEAF_NODE_ENTRY_SIZE;
+        left_count = 1;
+        while(left_count < total_cells - 1 && left_bytes * 2 < total_bytes){
+            left_bytes += sizes[left_count] + LEAF_NODE_ENTRY_SIZE;
+            left_count++;
+        }
+    }
+
+    initialize_leaf_node(pager, left);
+    *node_parent(left) = *node_parent(left_copy);
+    for(uint32_t i = 0; i < left_count; i++){
+        leaf_node_insert_cell(pager, left, i, cells[i], sizes[i]);
+    }
+    if(merge){
+        *leaf_node_next_leaf(left) = *leaf_node_next_leaf(right_copy);
+        internal_node_remove_child(parent, left_index + 1);
+        return true;
+    }
+
+    initialize_leaf_node(pager, right);
+    *node_parent(right) = *node_parent(right_copy);
+    *leaf_node_next_leaf(right) = *leaf_node_next_leaf(right_copy);
+    *leaf_node_next_leaf(left) = *leaf_node_next_leaf(left_copy);
+    for(uint32_t i = left_count; i < total_cells; i++){
+        leaf_node_insert_cell(pager, right, i - left_count, cells[i], sizes[i]);
+    }
+    *internal_node_key(parent, left_index) = *leaf_node_key(left, left_count - 1);
+    return false;
+}
+
+/**
+ * internal_nodes_rebalance: 父节点中相邻的内部节点 left、right 放得下时合并到 left，否则按孩子数平分
+ * 说明: left 原来的最右孩子在父节点中的键随之下移；搬到另一个节点的孩子要更新父指针
+ * 返回值: 是否合并；合并后 right 已从父节点中摘下，由调用方释放
+ */
+static bool internal_nodes_rebalance(Pager* pager, void* parent, uint32_t left_index, uint32_t left_page_num, void* left,
+                              uint32_t right_page_num, void* right){
+    uint32_t* children = pager->scratch.children;
+    uint32_t* keys = pager->scratch.keys;
+    uint32_t left_children = internal_node_read_children(left, children, keys);
+    keys[left_children - 1] = *internal_node_key(parent, left_index);
+    uint32_t total_children = left_children + internal_node_read_children(right, children + left_children,
+                                                                         keys + left_children);
+
+    if(total_children <= pager->internal_node_max_keys + 1){
+        internal_node_write_children(left, children, keys, total_children);
+        set_children_parent(pager, children, left_children, total_children, left_page_num);
+        internal_node_remove_child(parent, left_index + 1);
+        return true;
+    }
+
+    uint32_t left_count = total_children / 2;
+    internal_node_write_children(left, children, keys, left_count);
+    internal_node_write_children(right, children + left_count, keys + left_count, total_children - left_count);
+    *internal_node_key(parent, left_index) = keys[left_count - 1];
+    if(left_count > left_children){
+        set_children_parent(pager, children, left_children, left_count, left_page_num);
+    }
+    else{
+        set_children_parent(pager, children, left_count, left_children, right_page_num);
+    }
+    return false;
+}
+
+/**
+ * btree_rebalance_child: 删除后检查父节点的第 child_index 个孩子，过空时与相邻的兄弟合并或从兄弟借
+ * 说明: 调用方锁住了父节点，孩子已经放开。优先找左兄弟，两个孩子按从左到右的顺序加写锁，
+ *      与读者沿叶子链表加锁的顺序相同；内部节点只能从父节点进入，父节点锁住时没有读者能进来。
+ *      两个都很空的孩子合并后可能仍然过空，继续与新的兄弟合并；唯一的孩子没有兄弟，等父节点自己被合并
+ */
+static void btree_rebalance_child(Table* table, uint32_t parent_page_num, void* parent, uint32_t child_index){
+    Pager* pager = table->pager;
+    while(*internal_node_num_keys(parent) > 0){
+        uint32_t left_index = child_index > 0 ? child_index - 1 : 0;
+        uint32_t left_page_num = *internal_node_child(parent, left_index);
+        uint32_t right_page_num = *internal_node_child(parent, left_index + 1);
+        void* left = get_page_latched(pager, left_page_num, LATCH_EXCLUSIVE);
+        void* right = get_page_latched(pager, right_page_num, LATCH_EXCLUSIVE);
+        if(!node_is_underfull(pager, left_index == child_index ? left : right)){
+            release_page(pager, right_page_num);
+            release_page(pager, left_page_num);
+            return;
+        }
+
+        bool merged;
+        if(get_node_type(left) == NODE_LEAF){
+            merged = leaf_nodes_rebalance(pager, parent, left_index, left, right);
+        }
+        else{
+            merged = internal_nodes_rebalance(pager, parent, left_index, left_page_num, left, right_page_num, right);
+        }
+        pager_mark_dirty(pager, parent_page_num);
+        pager_mark_dirty(pager, left_page_num);
+        pager_mark_dirty(pager, right_page_num);
+        release_page(pager, right_page_num);
+        release_page(pager, left_page_num);
+        if(!merged){
+            // 借完后两边都超过一半
+            STAT_ADD(table->stats.borrows, 1);
+            return;
+        }
+        // right 已经不在树中，也不在叶子链表中，不会再有读者进入
+        STAT_ADD(table->stats.merges, 1);
+        pager_free_page(pager, right_page_num);
+        child_index = left_index;
+    }
+}
+
+/**
+ * btree_collapse_root: 根只剩一个孩子时把孩子的内容搬进根页并释放孩子，树降低一层
+ * 说明: 调用方锁住了根；根页号保持不变
+ */
+static void btree_collapse_root(Table* table, void* root){
+    Pager* pager = table->pager;
+    while(get_node_type(root) == NODE_INTERNAL && *internal_node_num_keys(root) == 0){
+        uint32_t child_page_num = *internal_node_right_child(root);
+        void* child = get_page_latched(pager, child_page_num, LATCH_EXCLUSIVE);
+        memcpy(root, child, pager->page_size);
+        set_node_root(root, true);
+        if(get_node_type(root) == NODE_INTERNAL){
+            update_children_parent(pager, root, table->root_page_num);
+        }
+        pager_mark_dirty(pager, table->root_page_num);
+        release_page(pager, child_page_num);
+        STAT_ADD(table->stats.merges, 1);
+        pager_free_page(pager, child_page_num);
+    }
+}
+
+/**
+ * LeafDeleter 在锁住的叶子中删除单元格的回调
+ * 返回值: 是否删除了单元格
+ */
+typedef bool (*LeafDeleter)(void* node, void* context);
+
+/**
+ * btree_delete_in_subtree: 在以已锁住的 node 为根的子树中找到 key 所在的叶子，由 deleter 删除单元格
+ * duplicates: 键可以重复（索引树），相同的键可能跨过几个孩子，要依次尝试
+ * 返回值: 是否删除了单元格；删除后这一层以下已经重新平衡
+ */
+static bool btree_delete_in_subtree(Table* table, uint32_t page_num, void* node, uint32_t key,
+                             bool duplicates, LeafDeleter deleter, void* context, uint32_t depth){
+    Pager* pager = table->pager;
+    if(get_node_type(node) == NODE_LEAF){
+        bool deleted = deleter(node, context);
+        if(deleted){
+            pager_mark_dirty(pager, page_num);
+        }
+        return deleted;
+    }
+    if(depth == MAX_TREE_DEPTH){
+        db_fail("Tree is deeper than %d levels.", MAX_TREE_DEPTH);
+    }
+
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for(uint32_t index = internal_node_find_child(node, key); index <= num_keys; index++){
+        uint32_t child_page_num = *internal_node_child(node, index);
+        void* child = get_page_latched(pager, child_page_num, LATCH_EXCLUSIVE);
+        bool deleted = btree_delete_in_subtree(table, child_page_num, child, key, duplicates, deleter, context, depth + 1);
+        release_page(pager, child_page_num);
+        if(deleted){
+            btree_rebalance_child(table, page_num, node, index);
+            return true;
+        }
+        if(!duplicates || index == num_keys || *internal_node_key(node, index) != key){
+            break;
+        }
+    }
+    return false;
+}
+
+/**
+ * btree_delete: 自顶向下加写锁找到 key 所在的叶子，由 deleter 删除其中的单元格，再自底向上重新平衡
+ * 返回值: 是否删除了单元格
+ * 说明: 调用方持有写者锁。合并可能一直传到根，所以路径上的节点一直锁到重新平衡结束；
+ *      每次只处理一个叶子，读者等待的时间很短。合并会释放页，缓存的最右叶子随之作废
+ */
+static bool btree_delete(Table* table, uint32_t key, bool duplicates, LeafDeleter deleter, void* context){
+    Pager* pager = table->pager;
+    table->rightmost_leaf = INVALID_PAGE_NUM;
+    void* root = get_page_latched(pager, table->root_page_num, LATCH_EXCLUSIVE);
+    bool deleted = btree_delete_in_subtree(table, table->root_page_num, root, key, duplicates, deleter, context, 0);
+    if(deleted){
+        btree_collapse_root(table, root);
+    }
+    release_page(pager, table->root_page_num);
+    return deleted;
+}
+
+/**
+ * btree_rebalance_in_subtree: 在以已锁住的 node 为根的子树中，重新平衡 keys 所在的过空叶子及其祖先
+ * keys: 升序排列，每个键落在一个过空的叶子中；合并时留下的节点接管被合并节点的范围，键仍然落在过空的节点中
+ * 返回值: node 只剩一个孩子。这个孩子（或它下面的节点）可能仍然过空，要等 node 与兄弟合并后再下降一次
+ * 说明: 同一个孩子中的键一起处理，每个孩子只下降一次；孩子处理完后只有它真的过空时才合并或借
+ */
+static bool btree_rebalance_in_subtree(Table* table, uint32_t page_num, void* node, const uint32_t* keys,
+                                       uint32_t num_keys, uint32_t depth){
+    if(get_node_type(node) == NODE_LEAF){
+        return false;
+    }
+    if(depth == MAX_TREE_DEPTH){
+        db_fail("Tree is deeper than %d levels.", MAX_TREE_DEPTH);
+    }
+    Pager* pager = table->pager;
+    uint32_t i = 0;
+    while(i < num_keys){
+        uint32_t index = internal_node_find_child(node, keys[i]);
+        uint32_t j = i + 1;
+        while(j < num_keys && internal_node_find_child(node, keys[j]) == index){
+            j++;
+        }
+        uint32_t child_page_num = *internal_node_child(node, index);
+        void* child = get_page_latched(pager, child_page_num, LATCH_EXCLUSIVE);
+        bool lone_child = btree_rebalance_in_subtree(table, child_page_num, child, keys + i, j - i, depth + 1);
+        release_page(pager, child_page_num);
+        if(*internal_node_num_keys(node) == 0){
+            return true;
+        }
+        btree_rebalance_child(table, page_num, node, index);
+        if(!lone_child){
+            i = j;
+        }
+        // 否则孩子已与兄弟合并或从兄弟借，它下面过空的节点有了兄弟，同一组键再下降一次
+    }
+    return *internal_node_num_keys(node) == 0;
+}
+
+/**
+ * btree_rebalance: 删除后自顶向下重新平衡 keys 所在的过空叶子，只调整真的变得过空的祖先
+ * 说明: 调用方持有写者锁；与 btree_delete 相同，路径上的节点一直锁到重新平衡结束。
+ *      根只剩一个孩子时树降低一层，下面仍然过空的节点这时才有兄弟，要再下降一次
+ */
+static void btree_rebalance(Table* table, const uint32_t* keys, uint32_t num_keys){
+    Pager* pager = table->pager;
+    table->rightmost_leaf = INVALID_PAGE_NUM;
+    void* root = get_page_latched(pager, table->root_page_num, LATCH_EXCLUSIVE);
+    while(btree_rebalance_in_subtree(table, table->root_page_num, root, keys, num_keys, 0)){
+        btree_collapse_root(table, root);
+    }
+    btree_collapse_root(table, root);
+    release_page(pager, table->root_page_num);
+}
+
+/**
+ * index_num_of_column: 列对应的索引编号（Table.indexes 的下标）
+ */
+static uint32_t index_num_of_column(Column column){
+    return column == COLUMN_USERNAME ? 0 : 1;
+}
+
+/**
+ * index_hash: 列值的 32 位 FNV-1a 哈希，作为索引树的键
+ */
+static uint32_t index_hash(const char* data, uint32_t length){
+    uint32_t hash = 2166136261u;
+    for(uint32_t i = 0; i < length; i++){
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * row_view_column: 行中某个字符串列的数据和长度
+ */
+static const char* row_view_column(RowView* view, Column column, uint32_t* length){
+    *length = column == COLUMN_USERNAME ? view->username_length : view->email_length;
+    return column == COLUMN_USERNAME ? view->username : view->email;
+}
+
+/**
+ * index_open: 创建访问索引树的 Table，与表共用分页器
+ */
+static Table* index_open(Pager* pager, uint32_t root_page_num){
+    Table* index = (Table*)calloc(1, sizeof(Table));
+    index->pager = pager;
+    index->root_page_num = root_page_num;
+    index->scan_threads = 1;
+    index->rightmost_leaf = INVALID_PAGE_NUM;
+    return index;
+}
+
+/**
+ * table_free_indexes: 释放表上的索引结构（不改动文件）
+ */
+static void table_free_indexes(Table* table){
+    for(uint32_t i = 0; i < NUM_INDEXED_COLUMNS; i++){
+        free(table->indexes[i]);
+        table->indexes[i] = NULL;
+    }
+}
+
+/**
+ * index_insert_entry: 在索引树中插入 hash -> id
+ * 说明: 调用方持有表的写者锁
+ */
+static void index_insert_entry(Table* index, uint32_t hash, uint32_t id){
+    uint8_t entry[INDEX_ENTRY_SIZE];
+    memcpy(entry, &hash, ID_SIZE);
+    entry[ID_SIZE] = sizeof(id);
+    memcpy(entry + INDEX_ENTRY_ID_OFFSET, &id, sizeof(id));
+    entry[INDEX_ENTRY_ID_OFFSET + sizeof(id)] = 0;
+    Cursor cursor;
+    table_find_for_insert(index, hash, INDEX_ENTRY_SIZE, &cursor);
+    leaf_node_insert(&cursor, entry, INDEX_ENTRY_SIZE);
+    cursor_close(&cursor);
+}
+
+/**
+ * index_insert_row: 把新插入的行加入表上所有的索引
+ */
+static void index_insert_row(Table* table, void* row){
+    RowView view;
+    row_view_init(row, &view);
+    for(Column column = COLUMN_USERNAME; column <= COLUMN_EMAIL; column++){
+        Table* index = table->indexes[index_num_of_column(column)];
+        if(index != NULL){
+            uint32_t length;
+            const char* data = row_view_column(&view, column, &length);
+            index_insert_entry(index, index_hash(data, length), view.id);
+        }
+    }
+}
+
+/**
+ * IndexEntryDelete 要从索引中删除的一项
+ */
+typedef struct{
+    uint32_t hash;
+    uint32_t id;
+}IndexEntryDelete;
+
+/**
+ * index_delete_in_leaf: 在叶子中找键为 hash、行 id 为 id 的索引项并删除
+ */
+static bool index_delete_in_leaf(void* node, void* context){
+    IndexEntryDelete* entry = (IndexEntryDelete*)context;
+    uint32_t num_cells = *leaf_node_num_cells(node);
+    uint32_t cell_num = leaf_node_search_keys(leaf_node_key(node, 0), num_cells, entry->hash);
+    for(; cell_num < num_cells && *leaf_node_key(node, cell_num) == entry->hash; cell_num++){
+        uint32_t id;
+        memcpy(&id, leaf_node_cell(node, cell_num) + INDEX_ENTRY_ID_OFFSET, sizeof(id));
+        if(id == entry->id){
+            leaf_node_delete_cell(node, cell_num);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * index_delete_row: 把要删除的行从表上所有的索引中删掉
+ * 说明: 调用方持有表的写者锁；找不到索引项说明索引与表不一致
+ */
+static void index_delete_row(Table* table, void* row){
+    RowView view;
+    row_view_init(row, &view);
+    for(Column column = COLUMN_USERNAME; column <= COLUMN_EMAIL; column++){
+        Table* index = table->indexes[index_num_of_column(column)];
+        if(index != NULL){
+            uint32_t length;
+            const char* data = row_view_column(&view, column, &length);
+            IndexEntryDelete entry = {index_hash(data, length), view.id};
+            if(!btree_delete(index, entry.hash, true, index_delete_in_leaf, &entry)){
+                db_fail("Index on column %d has no entry for id %d.", column, view.id);
+            }
+        }
+    }
+}
+
+static int compare_keys(const void* a, const void* b){
+    uint32_t key_a = *(const uint32_t*)a;
+    uint32_t key_b = *(const uint32_t*)b;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+static int compare_index_entries(const void* a, const void* b){
+    uint64_t value_a = *(const uint64_t*)a;
+    uint64_t value_b = *(const uint64_t*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * index_build: 扫描表，把所有行加入索引
+ * 说明: 先收集 (哈希, id) 并排序，再按键顺序插入，减少索引树上的随机访问
+ */
+static void index_build(Table* table, Table* index, Column column){
+    uint64_t capacity = 1024;
+    uint64_t num_entries = 0;
+    uint64_t* entries = (uint64_t*)malloc(sizeof(uint64_t) * capacity);
+    Cursor cursor;
+    table_seek(table, 0, &cursor);
+    RowView view;
+    while(!cursor.end_of_table){
+        row_view_init(cursor_value(&cursor), &view);
+        uint32_t length;
+        const char* data = row_view_column(&view, column, &length);
+        if(num_entries == capacity){
+            capacity *= 2;
+            entries = (uint64_t*)realloc(entries, sizeof(uint64_t) * capacity);
+        }
+        entries[num_entries++] = (uint64_t)index_hash(data, length) << 32 | view.id;
+        cursor_advance(&cursor);
+    }
+    cursor_close(&cursor);
+
+    qsort(entries, num_entries, sizeof(uint64_t), compare_index_entries);
+    for(uint64_t i = 0; i < num_entries; i++){
+        index_insert_entry(index, (uint32_t)(entries[i] >> 32), (uint32_t)entries[i]);
+    }
+    free(entries);
+}
+
+/**
+ * table_create_index: 在 column 上建索引: 分配根页、记入头页，再加入已有的行
+ * 说明: 调用方持有写者锁并负责提交
+ */
+static void table_create_index(Table* table, Column column){
+    Pager* pager = table->pager;
+    uint32_t root_page_num = get_unused_page_num(pager);
+    void* root = get_page(pager, root_page_num);
+    initialize_leaf_node(pager, root);
+    set_node_root(root, true);
+    pager_mark_dirty(pager, root_page_num);
+    unpin_page(pager, root_page_num);
+
+    uint32_t index_num = index_num_of_column(column);
+    void* header = get_page(pager, HEADER_PAGE_NUM);
+    *header_index_root(header, index_num) = root_page_num;
+    pager_mark_dirty(pager, HEADER_PAGE_NUM);
+    unpin_page(pager, HEADER_PAGE_NUM);
+
+    Table* index = index_open(pager, root_page_num);
+    index_build(table, index, column);
+    table->indexes[index_num] = index;
+}
+
+/**
+ * index_lookup: 取出索引中哈希等于 hash 的所有行 id，按 id 排序
+ * 返回值: id 个数，*ids 由调用方释放
+ * 说明: 重复的键可能跨过多个叶子，顺着叶子链表一直读到键变化为止；
+ *      哈希冲突的行也在其中，调用方还要比较列值
+ */
+static uint32_t index_lookup(Table* index, uint32_t hash, uint32_t** ids){
+    uint32_t capacity = 16;
+    uint32_t count = 0;
+    *ids = (uint32_t*)malloc(sizeof(uint32_t) * capacity);
+    Cursor cursor;
+    table_seek(index, hash, &cursor);
+    while(!cursor.end_of_table){
+        void* entry = cursor_value(&cursor);
+        if(*(uint32_t*)entry != hash){
+            break;
+        }
+        if(count == capacity){
+            capacity *= 2;
+            *ids = (uint32_t*)realloc(*ids, sizeof(uint32_t) * capacity);
+        }
+        memcpy(&(*ids)[count++], entry + INDEX_ENTRY_ID_OFFSET, sizeof(uint32_t));
+        cursor_advance(&cursor);
+    }
+    cursor_close(&cursor);
+    qsort(*ids, count, sizeof(uint32_t), compare_keys);
+    return count;
+}
+
+/**
+ * execute_create_index: 执行 create index on <列>
+ */
+static ExecuteResult execute_create_index(Statement* statement, Table* table){
+    db_mutex_lock(&table->writer_lock);
+    if(table->indexes[index_num_of_column(statement->index_column)] != NULL){
+        db_mutex_unlock(&table->writer_lock);
+        return EXECUTE_INDEX_EXISTS;
+    }
+    table_create_index(table, statement->index_column);
+    pager_commit(table->pager);
+    db_mutex_unlock(&table->writer_lock);
+    return EXECUTE_SUCCESS;
+}
+
+/**
+ * execute_insert: 执行插入语句
+ * 返回值: 执行结果
+ */
+ExecuteResult execute_insert(Statement* statement, Table* table){
+    uint32_t key_to_insert = statement->id_to_insert;
+    // 写者之间互斥，读者只在写者锁住的页上等待
+    db_mutex_lock(&table->writer_lock);
+    Cursor cursor;
+    if(!table_find_for_append(table, key_to_insert, statement->cell_to_insert_size, &cursor)){
+        table_find_for_insert(table, key_to_insert, statement->cell_to_insert_size, &cursor);
+        if(*leaf_node_next_leaf(cursor.node) == 0){
+            // 记下最右叶子；这次插入如果让它分裂，分裂时会换成新的最右叶子
+            table->rightmost_leaf = cursor.page_num;
+        }
+    }
+
+    uint32_t num_cells = (*leaf_node_num_cells(cursor.node));
+    if(cursor.cell_num < num_cells){
+        uint32_t key_at_index = *leaf_node_key(cursor.node,cursor.cell_num);
+        if(key_at_index == key_to_insert){
+            cursor_close(&cursor);
+            db_mutex_unlock(&table->writer_lock);
+            return EXECUTE_DUPLICATE_KEY;
+        }
+    }
+    leaf_node_insert(&cursor, statement->cell_to_insert, statement->cell_to_insert_size);
+    // 索引项加好之后才放开叶子的页锁: 读者能看到这一行时，按索引也一定能找到它
+    // （索引查询先取出 id 再回表，不会在持有索引页锁时等表的页锁，不会死锁）
+    index_insert_row(table, statement->cell_to_insert);
+    cursor_close(&cursor);
+    // 索引和表在同一次提交中修改；先放开页锁再提交，等待 fdatasync 时读者不受影响
+    pager_commit(table->pager);
+    db_mutex_unlock(&table->writer_lock);
+    return EXECUTE_SUCCESS;
+}
+
+/**
+ * DeleteRange 按 id 范围删除的进度
+ * end: id 范围的上界（包含）
+ * predicates / num_predicates: 字符串列上的条件，全部满足的行才删除
+ * deleted: 删除的行数
+ * keep_rows: 表上有索引，被删除的行要拷贝到 rows 中，放开表的页锁后再删除索引项
+ * rows / rows_size / rows_capacity: 当前叶子中被删除的行，按存储格式首尾相接
+ * underfull_keys / num_underfull / underfull_capacity: 删除后过空的叶子各自原有的一个键，按叶子顺序排列
+ */
+typedef struct{
+    uint32_t end;
+    Predicate* predicates;
+    uint32_t num_predicates;
+    uint64_t deleted;
+    bool keep_rows;
+    uint8_t* rows;
+    uint32_t rows_size;
+    uint32_t rows_capacity;
+    uint32_t* underfull_keys;
+    uint32_t num_underfull;
+    uint32_t underfull_capacity;
+}DeleteRange;
+
+/**
+ * delete_range_in_leaf: 从 cell_num 开始删除叶子中 id 不大于 end 且满足条件的行
+ * 返回值: 还要继续检查的下一个叶子，范围已经检查完时返回 0
+ * 说明: 只删除单元格，不改变树的结构；叶子变得过空时记下它原有的一个键，之后由 btree_rebalance 处理
+ */
+static uint32_t delete_range_in_leaf(Pager* pager, void* node, uint32_t cell_num, DeleteRange* range){
+    uint32_t first_key = *leaf_node_num_cells(node) > 0 ? *leaf_node_key(node, 0) : 0;
+    bool deleted = false;
+    RowView view;
+    while(cell_num < *leaf_node_num_cells(node) && *leaf_node_key(node, cell_num) <= range->end){
+        void* cell = leaf_node_cell(node, cell_num);
+        row_view_init(cell, &view);
+        bool matches = true;
+        for(uint32_t i = 0; i < range->num_predicates && matches; i++){
+            matches = predicate_matches(&range->predicates[i], &view);
+        }
+        if(!matches){
+            cell_num++;
+            continue;
+        }
+        if(range->keep_rows){
+            uint32_t size = stored_row_size(cell);
+            if(range->rows_size + size > range->rows_capacity){
+                range->rows_capacity = (range->rows_size + size) * 2;
+                range->rows = (uint8_t*)realloc(range->rows, range->rows_capacity);
+            }
+            memcpy(range->rows + range->rows_size, cell, size);
+            range->rows_size += size;
+        }
+        leaf_node_delete_cell(node, cell_num);
+        range->deleted++;
+        deleted = true;
+    }
+    if(deleted && node_is_underfull(pager, node)){
+        if(range->num_underfull == range->underfull_capacity){
+            range->underfull_capacity = range->underfull_capacity == 0 ? 16 : range->underfull_capacity * 2;
+            range->underfull_keys = (uint32_t*)realloc(range->underfull_keys,
+                                                       range->underfull_capacity * sizeof(uint32_t));
+        }
+        // 分隔键在重新平衡之前不变，叶子原有的任何一个键都能从根找回这个叶子
+        range->underfull_keys[range->num_underfull++] = first_key;
+    }
+    if(cell_num < *leaf_node_num_cells(node)){
+        // 遇到了大于 end 的键
+        return 0;
+    }
+    return *leaf_node_next_leaf(node);
+}
+
+/**
+ * table_delete: 删除 id 在 [start, end] 内且满足所有条件的行
+ * 返回值: 删除的行数
+ * 说明: 先沿叶子链表逐个叶子加写锁删除单元格，每次只锁一个叶子；
+ *      再从根下降一次，只让变得过空的叶子和祖先与兄弟合并或从兄弟借，空出的页放回空闲链表。
+ *      被删除的行同时从索引中删掉，所有修改在一次提交中完成
+ */
+uint64_t table_delete(Table* table, uint32_t start, uint32_t end, Predicate* predicates, uint32_t num_predicates){
+    Pager* pager = table->pager;
+    DeleteRange range = {0};
+    range.end = end;
+    range.predicates = predicates;
+    range.num_predicates = num_predicates;
+
+    db_mutex_lock(&table->writer_lock);
+    for(uint32_t i = 0; i < NUM_INDEXED_COLUMNS; i++){
+        range.keep_rows |= table->indexes[i] != NULL;
+    }
+    if(start <= end){
+        Cursor cursor;
+        table_find_latched(table, start, LATCH_EXCLUSIVE, &cursor);
+        uint32_t page_num = cursor.page_num;
+        void* node = cursor.node;
+        uint32_t cell_num = cursor.cell_num;
+        while(true){
+            range.rows_size = 0;
+            uint64_t deleted_before = range.deleted;
+            uint32_t next_page_num = delete_range_in_leaf(pager, node, cell_num, &range);
+            if(range.deleted > deleted_before){
+                pager_mark_dirty(pager, page_num);
+            }
+            // 写者锁之下叶子链表不会变，放开这个叶子后再锁下一个
+            release_page(pager, page_num);
+            for(uint32_t offset = 0; offset < range.rows_size; offset += stored_row_size(range.rows + offset)){
+                index_delete_row(table, range.rows + offset);
+            }
+            if(next_page_num == 0){
+                break;
+            }
+            page_num = next_page_num;
+            node = get_page_latched(pager, page_num, LATCH_EXCLUSIVE);
+            cell_num = 0;
+        }
+    }
+    if(range.num_underfull > 0){
+        btree_rebalance(table, range.underfull_keys, range.num_underfull);
+    }
+    free(range.rows);
+    free(range.underfull_keys);
+    if(range.deleted > 0){
+        pager_commit(pager);
+    }
+    db_mutex_unlock(&table->writer_lock);
+    return range.deleted;
+}
+
+/**
+ * execute_delete: 执行删除语句，删除的行数记在 statement->rows_deleted 中
+ */
+static ExecuteResult execute_delete(Statement* statement, Table* table){
+    uint32_t start = statement->has_id_range ? statement->id_start : 0;
+    uint32_t end = statement->has_id_range ? statement->id_end : UINT32_MAX;
+    statement->rows_deleted = table_delete(table, start, end, statement->predicates, statement->num_predicates);
+    return EXECUTE_SUCCESS;
+}
+
+/**
+ * scan_range: 扫描 id 在 [start, end] 中的行，满足条件的行打印到 out 或只计数
+ * 返回值: 满足条件的行数
+ */
+static uint64_t scan_range(Table* table, Statement* statement, uint32_t start, uint32_t end, FILE* out){
+    uint64_t count = 0;
+    Cursor cursor;
+    table_seek(table, start, &cursor);
+    RowView view;
+    while (!(cursor.end_of_table))
+    {
+        // 条件直接在页中的字节上判断，只有满足条件的行才解码输出选中的列
+        row_view_init(cursor_value(&cursor), &view);
+        if(view.id > end){
+            break;
+        }
+        bool matches = true;
+        for(uint32_t i = 0; i < statement->num_predicates && matches; i++){
+            matches = predicate_matches(&statement->predicates[i], &view);
+        }
+        if(matches){
+            count++;
+            if(!statement->count_only){
+                print_row(out, &view, statement->projection, statement->num_projected);
+            }
+        }
+        cursor_advance(&cursor);
+    }
+    cursor_close(&cursor);
+    return count;
+}
+
+/**
+ * find_index_predicate: 找一个能用索引的条件（建了索引的列上的等值条件）
+ * 返回值: 条件指针，没有时返回 NULL
+ */
+static Predicate* find_index_predicate(Statement* statement, Table* table){
+    for(uint32_t i = 0; i < statement->num_predicates; i++){
+        Predicate* predicate = &statement->predicates[i];
+        if(predicate->op == PREDICATE_EQUAL && table->indexes[index_num_of_column(predicate->column)] != NULL){
+            return predicate;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * scan_index: 通过索引找出候选行，再逐行回表检查所有条件
+ * 返回值: 满足条件的行数
+ * 说明: 候选 id 已排好序，输出顺序与全表扫描相同
+ */
+static uint64_t scan_index(Table* table, Statement* statement, Predicate* predicate, uint32_t start, uint32_t end,
+                    FILE* out){
+    Table* index = table->indexes[index_num_of_column(predicate->column)];
+    uint32_t* ids;
+    uint32_t num_ids = index_lookup(index, index_hash(predicate->value, predicate->value_length), &ids);
+    uint64_t count = 0;
+    RowView view;
+    for(uint32_t i = 0; i < num_ids; i++){
+        if(ids[i] < start || ids[i] > end){
+            continue;
+        }
+        Cursor cursor;
+        table_seek(table, ids[i], &cursor);
+        if(!cursor.end_of_table && *(uint32_t*)cursor_value(&cursor) == ids[i]){
+            row_view_init(cursor_value(&cursor), &view);
+            bool matches = true;
+            for(uint32_t j = 0; j < statement->num_predicates && matches; j++){
+                matches = predicate_matches(&statement->predicates[j], &view);
+            }
+            if(matches){
+                count++;
+                if(!statement->count_only){
+                    print_row(out, &view, statement->projection, statement->num_projected);
+                }
+            }
+        }
+        cursor_close(&cursor);
+    }
+    free(ids);
+    return count;
+}
+
+/**
+ * table_split_keys: 取树上层内部节点中的键作为并行扫描的分段边界
+ * 返回值: 边界个数，最多 num_chunks - 1 个，严格递增
+ * 说明: 内部节点的第 i 个键是第 i 个孩子中键的上界（删除后可能大于实际的最大键），所以这些键把键空间切成大小相近的子树；
+ *      从根开始一层一层往下走，每个节点只访问一次、每次只锁一个节点，边界足够或到达叶子时停下，多出来的边界均匀抽掉
+ */
+static uint32_t table_split_keys(Table* table, uint32_t* splits, uint32_t num_chunks){
+    Pager* pager = table->pager;
+    uint32_t max_keys = num_chunks * PARALLEL_SCAN_MAX_SPLIT_FACTOR;
+    uint32_t* keys = (uint32_t*)malloc(sizeof(uint32_t) * max_keys);
+    uint32_t num_keys = 0;
+    // 当前这一层的节点和下一层的节点
+    uint32_t level_capacity = 1;
+    uint32_t level_size = 1;
+    uint32_t* level = (uint32_t*)malloc(sizeof(uint32_t) * level_capacity);
+    level[0] = table->root_page_num;
+    for(uint32_t depth = 0; depth < MAX_TREE_DEPTH && level_size > 0 && num_keys + 1 < num_chunks; depth++){
+        uint32_t next_capacity = 16;
+        uint32_t next_size = 0;
+        uint32_t* next = (uint32_t*)malloc(sizeof(uint32_t) * next_capacity);
+        for(uint32_t i = 0; i < level_size && num_keys < max_keys; i++){
+            void* node = get_page_latched(pager, level[i], LATCH_SHARED);
+            if(get_node_type(node) != NODE_INTERNAL){
+                release_page(pager, level[i]);
+                break;
+            }
+            uint32_t node_num_keys = *internal_node_num_keys(node);
+            if(next_size + node_num_keys + 1 > next_capacity){
+                next_capacity = (next_size + node_num_keys + 1) * 2;
+                next = (uint32_t*)realloc(next, sizeof(uint32_t) * next_capacity);
+            }
+            for(uint32_t j = 0; j <= node_num_keys; j++){
+                next[next_size++] = *internal_node_child(node, j);
+                if(j < node_num_keys && num_keys < max_keys){
+                    keys[num_keys++] = *internal_node_key(node, j);
+                }
+            }
+            release_page(pager, level[i]);
+        }
+        free(level);
+        level = next;
+        level_size = next_size;
+    }
+    free(level);
+
+    // 收集期间可能有写者分裂节点，排序去重后再用
+    qsort(keys, num_keys, sizeof(uint32_t), compare_keys);
+    uint32_t num_unique = 0;
+    for(uint32_t i = 0; i < num_keys; i++){
+        if(num_unique == 0 || keys[i] != keys[num_unique - 1]){
+            keys[num_unique++] = keys[i];
+        }
+    }
+    uint32_t num_splits = num_unique < num_chunks - 1 ? num_unique : num_chunks - 1;
+    for(uint32_t i = 0; i < num_splits; i++){
+        splits[i] = keys[(uint64_t)(i + 1) * num_unique / (num_splits + 1)];
+    }
+    free(keys);
+    return num_splits;
+}
+
+/**
+ * ScanChunk 并行扫描中的一段 id 范围 [start, end]
+ * output / output_size: 该段打印的行（内存流），按段的顺序输出即为键序
+ * stream: 扫描期间写 output 的内存流
+ * count: 满足条件的行数
+ * done: 已扫描完（或扫描出错）
+ */
+typedef struct{
+    uint32_t start;
+    uint32_t end;
+    char* output;
+    size_t output_size;
+    FILE* stream;
+    uint64_t count;
+    bool done;
+}ScanChunk;
+
+/**
+ * ParallelScan 并行扫描的共享状态，由 mutex 保护
+ * next_chunk: 下一个待领取的段
+ * printed: 主线程已经输出的段数；工作线程最多领先 window 段，限制缓冲在内存里的输出
+ * failed / error_message: 某个工作线程出错及其错误消息，由主线程报告
+ */
+typedef struct{
+    Table* table;
+    Statement* statement;
+    ScanChunk* chunks;
+    uint32_t num_chunks;
+    uint32_t next_chunk;
+    uint32_t printed;
+    uint32_t window;
+    bool failed;
+    char error_message[DB_ERROR_MESSAGE_SIZE];
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+}ParallelScan;
+
+/**
+ * parallel_scan_worker: 工作线程不断领取下一段，用自己的游标扫描
+ * 说明: 工作线程没有调用方的跳转点，自己设一个: 出错时放开本线程持有的锁和页，
+ *      记下错误消息并让其余线程不再领取新段，由主线程在自己的线程里报告错误
+ */
+static void* parallel_scan_worker(void* arg){
+    ParallelScan* scan = (ParallelScan*)arg;
+    ScanChunk* volatile chunk = NULL;
+    jmp_buf jump;
+    if(setjmp(jump) != 0){
+        db_error_jump = NULL;
+        db_release_held(0);
+        pthread_mutex_lock(&scan->mutex);
+        if(!scan->failed){
+            scan->failed = true;
+            snprintf(scan->error_message, sizeof(scan->error_message), "%s", db_error_message);
+        }
+        scan->next_chunk = scan->num_chunks;
+        if(chunk != NULL){
+            chunk->done = true;
+        }
+        pthread_cond_broadcast(&scan->cond);
+        pthread_mutex_unlock(&scan->mutex);
+        return NULL;
+    }
+    db_error_jump = &jump;
+
+    pthread_mutex_lock(&scan->mutex);
+    while(scan->next_chunk < scan->num_chunks){
+        if(scan->next_chunk >= scan->printed + scan->window){
+            pthread_cond_wait(&scan->cond, &scan->mutex);
+            continue;
+        }
+        chunk = &scan->chunks[scan->next_chunk++];
+        pthread_mutex_unlock(&scan->mutex);
+
+        if(!scan->statement->count_only){
+            chunk->stream = open_memstream(&chunk->output, &chunk->output_size);
+        }
+        chunk->count = scan_range(scan->table, scan->statement, chunk->start, chunk->end, chunk->stream);
+
+        pthread_mutex_lock(&scan->mutex);
+        chunk->done = true;
+        pthread_cond_broadcast(&scan->cond);
+    }
+    pthread_mutex_unlock(&scan->mutex);
+    db_error_jump = NULL;
+    return NULL;
+}
+
+/**
+ * execute_select_parallel: 把 [start, end] 按树上层的键切成若干段，由 num_threads 个线程并行扫描
+ * 返回值: 满足条件的行数
+ * 说明: 主线程按段的顺序输出各段的结果，输出顺序与单线程扫描相同；
+ *      计数查询不产生输出，只把各段的计数加起来
+ */
+static uint64_t execute_select_parallel(Statement* statement, Table* table, uint32_t start, uint32_t end,
+                                 uint32_t num_threads){
+    uint32_t target = num_threads * PARALLEL_SCAN_CHUNKS_PER_THREAD;
+    uint32_t* splits = (uint32_t*)malloc(sizeof(uint32_t) * target);
+    uint32_t num_splits = table_split_keys(table, splits, target);
+
+    ParallelScan scan;
+    scan.table = table;
+    scan.statement = statement;
+    scan.chunks = (ScanChunk*)calloc(num_splits + 1, sizeof(ScanChunk));
+    scan.num_chunks = 0;
+    scan.next_chunk = 0;
+    scan.printed = 0;
+    scan.window = num_threads * 2;
+    scan.failed = false;
+    uint32_t chunk_start = start;
+    for(uint32_t i = 0; i <= num_splits; i++){
+        uint32_t chunk_end = i < num_splits && splits[i] < end ? splits[i] : end;
+        if(chunk_end < chunk_start){
+            continue;
+        }
+        scan.chunks[scan.num_chunks].start = chunk_start;
+        scan.chunks[scan.num_chunks].end = chunk_end;
+        scan.num_chunks++;
+        if(chunk_end == end){
+            break;
+        }
+        chunk_start = chunk_end + 1;
+    }
+    free(splits);
+    if(scan.num_chunks == 1){
+        // 树只有一层，或者范围落在一棵子树内
+        free(scan.chunks);
+        return scan_range(table, statement, start, end, stdout);
+    }
+    pthread_mutex_init(&scan.mutex, NULL);
+    pthread_cond_init(&scan.cond, NULL);
+
+    uint32_t num_workers = num_threads < scan.num_chunks ? num_threads : scan.num_chunks;
+    pthread_t* workers = (pthread_t*)malloc(sizeof(pthread_t) * num_workers);
+    for(uint32_t i = 0; i < num_workers; i++){
+        if(pthread_create(&workers[i], NULL, parallel_scan_worker, &scan) != 0){
+            // 已经启动的线程还在用 scan，等它们退出后再报告
+            pthread_mutex_lock(&scan.mutex);
+            scan.failed = true;
+            snprintf(scan.error_message, sizeof(scan.error_message), "Cannot create scan thread.");
+            scan.next_chunk = scan.num_chunks;
+            pthread_mutex_unlock(&scan.mutex);
+            num_workers = i;
+            break;
+        }
+    }
+
+    uint64_t count = 0;
+    pthread_mutex_lock(&scan.mutex);
+    while(scan.printed < scan.num_chunks && !scan.failed){
+        ScanChunk* chunk = &scan.chunks[scan.printed];
+        if(!chunk->done){
+            pthread_cond_wait(&scan.cond, &scan.mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&scan.mutex);
+        count += chunk->count;
+        if(chunk->stream != NULL){
+            fclose(chunk->stream);
+            chunk->stream = NULL;
+            fwrite(chunk->output, 1, chunk->output_size, stdout);
+            free(chunk->output);
+        }
+        pthread_mutex_lock(&scan.mutex);
+        scan.printed++;
+        pthread_cond_broadcast(&scan.cond);
+    }
+    pthread_mutex_unlock(&scan.mutex);
+
+    for(uint32_t i = 0; i < num_workers; i++){
+        pthread_join(workers[i], NULL);
+    }
+    // 出错后没有输出的段只释放缓冲
+    for(uint32_t i = scan.printed; i < scan.num_chunks; i++){
+        if(scan.chunks[i].stream != NULL){
+            fclose(scan.chunks[i].stream);
+            free(scan.chunks[i].output);
+        }
+    }
+    free(workers);
+    free(scan.chunks);
+    pthread_mutex_destroy(&scan.mutex);
+    pthread_cond_destroy(&scan.cond);
+    if(scan.failed){
+        db_fail("%s", scan.error_message);
+    }
+    return count;
+}
+
+/**
+ * execute_select: 执行查询语句
+ * 返回值: 执行结果
+ * 说明: 该函数遍历表中的所有行（或 id 范围内的行），打印满足条件的行中选中的列；
+ *      count(*) 只打印满足条件的行数。
+ *      建了索引的列上有等值条件时走索引（只查一个 id 时主键更快），否则 scan_threads 大于 1 时并行扫描
+ */
+static ExecuteResult execute_select(Statement* statement, Table* table){
+    // 限定了 id 范围时直接定位到下界，越过上界就停止
+    uint32_t start = statement->has_id_range ? statement->id_start : 0;
+    uint32_t end = statement->has_id_range ? statement->id_end : UINT32_MAX;
+    Predicate* index_predicate = start < end ? find_index_predicate(statement, table) : NULL;
+    uint64_t count;
+    if(index_predicate != NULL){
+        count = scan_index(table, statement, index_predicate, start, end, stdout);
+    }
+    else if(table->scan_threads > 1 && start < end){
+        count = execute_select_parallel(statement, table, start, end, table->scan_threads);
+    }
+    else{
+        count = scan_range(table, statement, start, end, stdout);
+    }
+    if(statement->count_only){
+        printf("(%" PRIu64 ")\n", count);
+    }
+
+    return EXECUTE_SUCCESS;
+}
+
+/**
+ * execute_statement: 执行语句
+ * 返回值: 执行结果
+ */
+ExecuteResult execute_statement(Statement* statement, Table* table){
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    ExecuteResult result;
+    switch(statement->type){
+        case STATEMENT_INSERT:
+            result = execute_insert(statement, table);
+            break;
+        case STATEMENT_SELECT:
+            result = execute_select(statement, table);
+            break;
+        case STATEMENT_CREATE_INDEX:
+            result = execute_create_index(statement, table);
+            break;
+        case STATEMENT_DELETE:
+            result = execute_delete(statement, table);
+            break;
+        default:
+            return EXECUTE_UNRECOGNIZED_STATEMENT;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    STAT_ADD(table->stats.statements, 1);
+    STAT_ADD(table->stats.statement_ns, (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ull + end.tv_nsec - start.tv_nsec);
+    return result;
+}
+
+
+/**
+ * BulkLevel 批量加载时某一层正在填充的节点
+ * page_num: 节点页号
+ * num_entries: 叶子中的单元格数 / 内部节点中的孩子数
+ * max_key: 节点中目前最大的键
+ */
+typedef struct{
+    uint32_t page_num;
+    uint32_t num_entries;
+    uint32_t max_key;
+}BulkLevel;
+
+#define BULK_LOAD_MAX_LEVELS 32
+
+/**
+ * BulkLoader 自底向上建树的状态
+ * levels[0] 是叶子层，levels[num_levels - 1] 是最高层，最高层的节点始终放在根页中
+ * leaf_capacity: 每个叶子最多使用的字节数（单元格指针加内容）
+ */
+typedef struct{
+    Table* table;
+    BulkLevel levels[BULK_LOAD_MAX_LEVELS];
+    uint32_t num_levels;
+    uint32_t leaf_capacity;
+    uint32_t internal_capacity;
+}BulkLoader;
+
+static void bulk_load_append_child(BulkLoader* loader, uint32_t level, uint32_t child_page_num, uint32_t child_max);
+
+/**
+ * bulk_load_open_node: 在 level 层开一个新节点
+ * 说明: 最高层已满时，把根页中的节点搬到新页，根页变为更高一层的节点，
+ *      这样根页号保持不变，且页号按写入顺序递增
+ */
+static void bulk_load_open_node(BulkLoader* loader, uint32_t level){
+    Pager* pager = loader->table->pager;
+    BulkLevel* current = &loader->levels[level];
+
+    if(level == loader->num_levels - 1){
+        if(loader->num_levels == BULK_LOAD_MAX_LEVELS){
+            db_fail("Bulk load tree too deep.");
+        }
+        uint32_t root_page_num = loader->table->root_page_num;
+        uint32_t moved_page_num = get_unused_page_num(pager);
+        void* root = get_page(pager, root_page_num);
+        void* moved = get_page(pager, moved_page_num);
+        memcpy(moved, root, pager->page_size);
+        set_node_root(moved, false);
+        *node_parent(moved) = root_page_num;
+        if(get_node_type(moved) == NODE_INTERNAL){
+            update_children_parent(pager, moved, moved_page_num);
+        }
+
+        initialize_internal_node(root);
+        set_node_root(root, true);
+        *internal_node_right_child(root) = moved_page_num;
+
+        pager_mark_dirty(pager, moved_page_num);
+        pager_mark_dirty(pager, root_page_num);
+        unpin_page(pager, moved_page_num);
+        unpin_page(pager, root_page_num);
+
+        loader->levels[level + 1].page_num = root_page_num;
+        loader->levels[level + 1].num_entries = 1;
+        loader->levels[level + 1].max_key = current->max_key;
+        loader->num_levels++;
+        current->page_num = moved_page_num;
+    }
+    else{
+        // 已满的节点挂到上一层
+        bulk_load_append_child(loader, level + 1, current->page_num, current->max_key);
+    }
+
+    // 在本层开一个新节点
+
+    uint32_t page_num = get_unused_page_num(pager);
+    void* node = get_page(pager, page_num);
+    if(level == 0){
+        initialize_leaf_node(pager, node);
+        void* prev = get_page(pager, current->page_num);
+        *leaf_node_next_leaf(prev) = page_num;
+        pager_mark_dirty(pager, current->page_num);
+        unpin_page(pager, current->page_num);
+    }
+    else{
+        initialize_internal_node(node);
+    }
+    pager_mark_dirty(pager, page_num);
+    unpin_page(pager, page_num);
+
+    current->page_num = page_num;
+    current->num_entries = 0;
+}
+
+/**
+ * bulk_load_append_child: 把已经写满的孩子追加到 level 层正在填充的内部节点末尾
+ */
+static void bulk_load_append_child(BulkLoader* loader, uint32_t level, uint32_t child_page_num, uint32_t child_max){
+    Pager* pager = loader->table->pager;
+    BulkLevel* current = &loader->levels[level];
+    if(current->num_entries >= loader->internal_capacity){
+        bulk_load_open_node(loader, level);
+    }
+
+    void* node = get_page(pager, current->page_num);
+    if(current->num_entries > 0){
+        // 原来的最右孩子变成普通单元格
+        uint32_t num_keys = *internal_node_num_keys(node);
+        *internal_node_cell(node, num_keys) = *internal_node_right_child(node);
+        *internal_node_key(node, num_keys) = current->max_key;
+        *internal_node_num_keys(node) = num_keys + 1;
+    }
+    *internal_node_right_child(node) = child_page_num;
+    pager_mark_dirty(pager, current->page_num);
+    unpin_page(pager, current->page_num);
+
+    void* child = get_page(pager, child_page_num);
+    *node_parent(child) = current->page_num;
+    pager_mark_dirty(pager, child_page_num);
+    unpin_page(pager, child_page_num);
+
+    current->num_entries++;
+    current->max_key = child_max;
+}
+
+/**
+ * btree_free_descendants: 把 node 下面的所有页放回空闲链表，node 本身保留
+ */
+static void btree_free_descendants(Pager* pager, void* node){
+    if(get_node_type(node) != NODE_INTERNAL){
+        return;
+    }
+    uint32_t num_keys = *internal_node_num_keys(node);
+    for(uint32_t i = 0; i <= num_keys; i++){
+        uint32_t child_page_num = *internal_node_child(node, i);
+        btree_free_descendants(pager, get_page(pager, child_page_num));
+        unpin_page(pager, child_page_num);
+        pager_free_page(pager, child_page_num);
+    }
+}
+
+/**
+ * table_bulk_load: 把按键严格递增的行批量加载到空表中
+ * fill_percent: 叶子和内部节点的填充率（1-100）
+ * 返回值: 表非空时返回 EXECUTE_TABLE_NOT_EMPTY，键不递增时返回 EXECUTE_DUPLICATE_KEY，此时表恢复为空
+ * 说明: 叶子按顺序填满后再开下一个，内部节点在同一遍中随之自底向上建好，
+ *      新页按文件顺序分配，不经过 table_find 和逐行分裂；
+ *      建树期间持有写者锁和根页的写锁，读者在根页上等待，看不到建了一半的树
+ */
+ExecuteResult table_bulk_load(Table* table, RowSource* source, uint32_t fill_percent){
+    Pager* pager = table->pager;
+    db_mutex_lock(&table->writer_lock);
+    void* root = get_page_latched(pager, table->root_page_num, LATCH_EXCLUSIVE);
+    if(get_node_type(root) != NODE_LEAF || *leaf_node_num_cells(root) != 0){
+        release_page(pager, table->root_page_num);
+        db_mutex_unlock(&table->writer_lock);
+        return EXECUTE_TABLE_NOT_EMPTY;
+    }
+
+    if(fill_percent == 0 || fill_percent > 100){
+        fill_percent = 100;
+    }
+    // 根页会变成内部节点，最右叶子等下一次插入时再找
+    table->rightmost_leaf = INVALID_PAGE_NUM;
+    BulkLoader loader;
+    loader.table = table;
+    loader.num_levels = 1;
+    loader.leaf_capacity = pager->leaf_node_space_for_cells * fill_percent / 100;
+    loader.internal_capacity = (pager->internal_node_max_keys + 1) * fill_percent / 100;
+    if(loader.leaf_capacity < 1){
+        loader.leaf_capacity = 1;
+    }
+    if(loader.internal_capacity < 2){
+        loader.internal_capacity = 2;
+    }
+    loader.levels[0].page_num = table->root_page_num;
+    loader.levels[0].num_entries = 0;
+    loader.levels[0].max_key = 0;
+
+    ExecuteResult result = EXECUTE_SUCCESS;
+    Row row;
+    while(source->next(source->context, &row)){
+        BulkLevel* leaf_level = &loader.levels[0];
+        if(leaf_level->num_entries > 0 && row.id <= leaf_level->max_key){
+            result = EXECUTE_DUPLICATE_KEY;
+            break;
+        }
+        uint8_t cell[ROW_MAX_SIZE];
+        uint32_t cell_size = serialize_row(&row, cell);
+        void* leaf = get_page(pager, leaf_level->page_num);
+        uint32_t used = pager->leaf_node_space_for_cells - leaf_node_free_space(leaf);
+        if(leaf_level->num_entries > 0 && used + cell_size + LEAF_NODE_ENTRY_SIZE > loader.leaf_capacity){
+            unpin_page(pager, leaf_level->page_num);
+            bulk_load_open_node(&loader, 0);
+            leaf = get_page(pager, leaf_level->page_num);
+        }
+        leaf_node_insert_cell(pager, leaf, leaf_level->num_entries, cell, cell_size);
+        pager_mark_dirty(pager, leaf_level->page_num);
+        unpin_page(pager, leaf_level->page_num);
+
+        leaf_level->num_entries++;
+        leaf_level->max_key = row.id;
+    }
+
+    // 把每层最后一个节点挂到上一层，最高层就是根
+    for(uint32_t level = 0; level + 1 < loader.num_levels; level++){
+        bulk_load_append_child(&loader, level + 1, loader.levels[level].page_num, loader.levels[level].max_key);
+    }
+    if(result != EXECUTE_SUCCESS){
+        // 丢掉已经建好的部分，根页变回空叶子，表和加载前一样
+        btree_free_descendants(pager, root);
+        initialize_leaf_node(pager, root);
+        set_node_root(root, true);
+        pager_mark_dirty(pager, table->root_page_num);
+        release_page(pager, table->root_page_num);
+        pager_commit(pager);
+        db_mutex_unlock(&table->writer_lock);
+        return result;
+    }
+
+    release_page(pager, table->root_page_num);
+    // 表原来是空的，索引也是空的，把载入的行补进去
+    for(Column column = COLUMN_USERNAME; column <= COLUMN_EMAIL; column++){
+        Table* index = table->indexes[index_num_of_column(column)];
+        if(index != NULL){
+            index_build(table, index, column);
+        }
+    }
+    pager_commit(pager);
+    db_mutex_unlock(&table->writer_lock);
+    return result;
+}
+
+/**
+ * 以游标作为数据源，按键顺序产出表中所有行
+ */
+static bool cursor_source_next(void* context, Row* row){
+    Cursor* cursor = (Cursor*)context;
+    if(cursor->end_of_table){
+        return false;
+    }
+    deserialize_row(cursor_value(cursor), row);
+    cursor_advance(cursor);
+    return true;
+}
+
+static void table_attach(Table* table, Pager* pager);
+
+/**
+ * fsync_directory: 让 filename 所在目录中的改名落盘
+ */
+static void fsync_directory(const char* filename){
+    char directory[PATH_MAX];
+    const char* slash = strrchr(filename, '/');
+    if(slash == NULL){
+        strcpy(directory, ".");
+    }
+    else{
+        size_t length = slash == filename ? 1 : (size_t)(slash - filename);
+        snprintf(directory, sizeof(directory), "%.*s", (int)length, filename);
+    }
+    int fd = open(directory, O_RDONLY | O_DIRECTORY);
+    if(fd == -1){
+        db_fail("Error opening directory %s: %s", directory, strerror(errno));
+    }
+    if(fsync(fd) == -1){
+        close(fd);
+        db_fail("Error syncing directory %s: %s", directory, strerror(errno));
+    }
+    close(fd);
+}
+
+/**
+ * pager_discard: 丢掉缓冲池中尚未写回的修改后关闭分页器，用于放弃一个临时文件
+ */
+static void pager_discard(Pager* pager){
+    for(uint32_t i = 0; i < pager->num_frames; i++){
+        pager->frames[i].dirty = false;
+    }
+    pager_close(pager);
+}
+
+/**
+ * table_checkpoint: 持有写者锁做检查点
+ * 说明: pager_checkpoint 会先提交缓冲池中的脏页，不拿写者锁时会把其他连接写到一半的语句提前提交
+ */
+void table_checkpoint(Table* table){
+    db_mutex_lock(&table->writer_lock);
+    pager_checkpoint(table->pager);
+    db_mutex_unlock(&table->writer_lock);
+}
+
+/**
+ * table_vacuum: 把表重建到新文件中再替换原文件
+ * 说明: 与 SQLite 的 VACUUM 一样，按键顺序把所有行批量加载到临时文件，
+ *      页被填满且按顺序排列，空闲页全部消失，文件随之缩短；
+ *      持有写者锁，调用方保证没有其他线程在读这张表。
+ *      临时文件改名替换原文件之前原文件一直开着，这之前出错只删掉临时文件，表照常可用
+ */
+void table_vacuum(Table* table){
+    Pager* pager = table->pager;
+    db_mutex_lock(&table->writer_lock);
+    pager_commit(pager);
+    if(pager->wal){
+        wal_checkpoint(pager);
+    }
+    else{
+        pager_flush_all(pager);
+    }
+    char filename[PATH_MAX];
+    snprintf(filename, sizeof(filename), "%s", pager->filename);
+    PagerConfig config = pager->config;
+
+    char vacuum_filename[PATH_MAX + 8];
+    snprintf(vacuum_filename, sizeof(vacuum_filename), "%s-vacuum", filename);
+    unlink(vacuum_filename);
+    PagerConfig vacuum_config = config;
+    vacuum_config.use_wal = false;
+    vacuum_config.page_size = pager->page_size;
+    Table* vacuum_table = (Table*)calloc(1, sizeof(Table));
+    pthread_mutex_init(&vacuum_table->writer_lock, NULL);
+
+    jmp_buf jump;
+    jmp_buf* outer_jump = db_error_jump;
+    uint32_t held_mark = db_held_mark();
+    if(setjmp(jump) != 0){
+        // 丢掉临时文件，再把错误交给外层
+        char message[DB_ERROR_MESSAGE_SIZE];
+        snprintf(message, sizeof(message), "%s", db_error_message);
+        db_error_jump = outer_jump;
+        db_release_held(held_mark);
+        if(vacuum_table->pager != NULL){
+            pager_discard(vacuum_table->pager);
+        }
+        unlink(vacuum_filename);
+        table_free_indexes(vacuum_table);
+        pthread_mutex_destroy(&vacuum_table->writer_lock);
+        free(vacuum_table);
+        db_mutex_unlock(&table->writer_lock);
+        db_fail("%s", message);
+    }
+    db_error_jump = &jump;
+
+    table_attach(vacuum_table, pager_open(vacuum_filename, &vacuum_config));
+    Cursor cursor;
+    table_start(table, &cursor);
+    RowSource source = {cursor_source_next, &cursor};
+    table_bulk_load(vacuum_table, &source, 100);
+    cursor_close(&cursor);
+    // 索引在新文件里重建
+    for(Column column = COLUMN_USERNAME; column <= COLUMN_EMAIL; column++){
+        if(table->indexes[index_num_of_column(column)] != NULL){
+            table_create_index(vacuum_table, column);
+        }
+    }
+
+    pager_flush_all(vacuum_table->pager);
+    if(fsync(vacuum_table->pager->file_descriptor) == -1){
+        db_fail("Error syncing file: %d", errno);
+    }
+    Pager* vacuum_pager = vacuum_table->pager;
+    vacuum_table->pager = NULL;
+    pager_close(vacuum_pager);
+    if(rename(vacuum_filename, filename) == -1){
+        db_fail("Error replacing %s: %s", filename, strerror(errno));
+    }
+    db_error_jump = outer_jump;
+    table_free_indexes(vacuum_table);
+    pthread_mutex_destroy(&vacuum_table->writer_lock);
+    free(vacuum_table);
+
+    // 原文件的修改已经全部写回，关闭时不会再写；换成新文件后计数接着累加
+    PagerStats stats = pager->stats;
+    pager_close(pager);
+    table->pager = NULL;
+    table_free_indexes(table);
+    table_attach(table, pager_open(filename, &config));
+    table->pager->stats = stats;
+    fsync_directory(filename);
+    db_mutex_unlock(&table->writer_lock);
+}
+
+/**
+ * pager_config_init: 填充默认的分页器配置
+ */
+void pager_config_init(PagerConfig* config){
+    config->pool_frames = DEFAULT_POOL_FRAMES;
+    config->use_mmap = false;
+    config->mmap_size = DEFAULT_MMAP_SIZE;
+    config->use_wal = false;
+    config->wal_group_commit = DEFAULT_WAL_GROUP_COMMIT;
+    config->wal_checkpoint_frames = DEFAULT_WAL_CHECKPOINT_FRAMES;
+    config->use_huge_pages = false;
+    config->use_direct_io = false;
+    config->page_size = DEFAULT_PAGE_SIZE;
+}
+
+/**
+ * frame_arena_alloc: 一次性分配缓冲池所有帧的页数据
+ * 说明: 匿名映射得到一整块按页对齐的内存，帧之间没有分配器的头部，长时间运行也不会产生碎片；
+ *      要求大页时先试 MAP_HUGETLB（需要系统预留大页），不行再退回普通页并用 madvise 建议透明大页
+ */
+static void frame_arena_alloc(Pager* pager){
+    size_t size = (size_t)pager->num_frames * pager->page_size;
+    pager->frame_arena = MAP_FAILED;
+    pager->frame_arena_huge = false;
+    if(pager->config.use_huge_pages){
+        size_t huge_size = (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        pager->frame_arena = mmap(NULL, huge_size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(pager->frame_arena != MAP_FAILED){
+            size = huge_size;
+            pager->frame_arena_huge = true;
+        }
+    }
+    if(pager->frame_arena == MAP_FAILED){
+        pager->frame_arena = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(pager->frame_arena == MAP_FAILED){
+            db_fail("Error allocating buffer pool: %s", strerror(errno));
+        }
+        if(pager->config.use_huge_pages){
+            // 内核不支持透明大页时只是得不到大页，忽略错误
+            madvise(pager->frame_arena, size, MADV_HUGEPAGE);
+        }
+    }
+    pager->frame_arena_size = size;
+}
+
+/**
+ * pager_read_page_size: 确定要打开的数据库的页大小
+ * 说明: 已有文件以头页中记录的为准（没有记录的旧文件在 table_attach 中拒绝）；刚建的库在第一次检查点之前
+ *      页可能都还在日志里，数据库文件是空的，这时取日志头中的页大小；都没有时用配置的页大小
+ */
+static uint32_t pager_read_page_size(int fd, off_t file_length, const char* filename, const PagerConfig* config){
+    uint32_t page_size = config->page_size;
+    if(file_length >= MIN_PAGE_SIZE){
+        // 文件可能以 O_DIRECT 打开，缓冲区和长度都要按页对齐
+        void* header;
+        if(posix_memalign(&header, MIN_PAGE_SIZE, MIN_PAGE_SIZE) != 0){
+            db_fail("Out of memory.");
+        }
+        if(pread(fd, header, MIN_PAGE_SIZE, 0) != MIN_PAGE_SIZE){
+            db_fail("Error reading file: %d", errno);
+        }
+        page_size = DEFAULT_PAGE_SIZE;
+        if(strncmp(header_magic(header), DB_HEADER_MAGIC, HEADER_MAGIC_SIZE) == 0 && *header_page_size(header) != 0){
+            page_size = *header_page_size(header);
+        }
+        free(header);
+    }
+    else if(file_length == 0){
+        char wal_filename[PATH_MAX];
+        snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+        int wal_fd = open(wal_filename, O_RDONLY);
+        if(wal_fd != -1){
+            uint32_t wal_header[3];
+            if(pread(wal_fd, wal_header, sizeof(wal_header), 0) == sizeof(wal_header)
+               && wal_header[0] == WAL_MAGIC && wal_header[1] == WAL_VERSION){
+                page_size = wal_header[2];
+            }
+            close(wal_fd);
+        }
+    }
+    if(!page_size_is_valid(page_size)){
+        db_fail("Unsupported page size %u (must be a power of two from %u to %u).",
+                page_size, MIN_PAGE_SIZE, MAX_PAGE_SIZE);
+    }
+    return page_size;
+}
+
+Pager* pager_open(const char* filename, const PagerConfig* config){
+    int flags = O_RDWR | O_CREAT;
+    if(config->use_direct_io){
+        if(config->use_mmap){
+            db_fail("Direct I/O is not supported in mmap mode.");
+        }
+        // 数据库文件的读写都经过帧或按页对齐的缓冲区，满足 O_DIRECT 的对齐要求
+        flags |= O_DIRECT;
+    }
+    int fd = open(filename, flags, S_IWUSR | S_IRUSR);
+    if(fd == -1){
+        db_fail("Error opening file %s: %s", filename, strerror(errno));
+    }
+    off_t file_length = lseek(fd, 0, SEEK_END);
+    uint32_t page_size = pager_read_page_size(fd, file_length, filename, config);
+
+    Pager* pager = (Pager*)calloc(1, sizeof(Pager));
+    pager_layout_init(pager, page_size);
+    pager->filename = strdup(filename);
+    pager->config = *config;
+    pager->file_descriptor = fd;
+    pager->file_length = file_length;
+    pager->num_pages = file_length / pager->page_size;
+    if(file_length % pager->page_size != 0){
+        db_fail("Db file is not a whole number of pages. Corrupt file?");
+    }
+
+    pager->wal = NULL;
+    pager->use_mmap = config->use_mmap;
+    pager->map = NULL;
+    pager->map_size = 0;
+    pager->map_pins = 0;
+    if(pager->use_mmap){
+        // 映射长度可以超过文件长度，越过文件尾的部分在 ftruncate 扩展后才会被访问
+        pager->map_size = config->mmap_size;
+        if(pager->map_size < (size_t)file_length){
+            pager->map_size = file_length;
+        }
+        if(pager->map_size < MMAP_GROW_PAGES * pager->page_size){
+            pager->map_size = MMAP_GROW_PAGES * pager->page_size;
+        }
+        pager->map_size = (pager->map_size + pager->page_size - 1) / pager->page_size * pager->page_size;
+        pager->map = mmap(NULL, pager->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if(pager->map == MAP_FAILED){
+            db_fail("Error mapping file %s: %s", filename, strerror(errno));
+        }
+    }
+
+    // 分配固定数量的帧，之后不再按页申请内存；mmap 模式不需要缓冲池
+    pager->num_frames = pager->use_mmap ? 0 : config->pool_frames;
+    if(!pager->use_mmap && pager->num_frames < MIN_POOL_FRAMES){
+        pager->num_frames = MIN_POOL_FRAMES;
+    }
+    pager->frame_arena = NULL;
+    pager->frame_arena_size = 0;
+    pager->frame_arena_huge = false;
+    if(pager->num_frames > 0){
+        frame_arena_alloc(pager);
+    }
+    pager->frames = (Frame*)malloc(sizeof(Frame) * pager->num_frames);
+    for (uint32_t i = 0; i < pager->num_frames; i++)
+    {
+        pager->frames[i].page_num = INVALID_PAGE_NUM;
+        pager->frames[i].pin_count = 0;
+        pager->frames[i].dirty = false;
+        pager->frames[i].referenced = false;
+        pager->frames[i].hash_next = -1;
+        pager->frames[i].data = pager->frame_arena + (size_t)i * pager->page_size;
+        pthread_rwlock_init(&pager->frames[i].latch, NULL);
+    }
+    pager->clock_hand = 0;
+
+    // 缓冲池锁可重入: 提交、检查点等持锁的路径内部还会调用 get_page
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&pager->mutex, &mutex_attr);
+    pthread_mutexattr_destroy(&mutex_attr);
+
+    // 哈希桶数取不小于帧数两倍的 2 的幂，保证链很短
+    uint32_t num_buckets = 1;
+    while(num_buckets < 2 * pager->num_frames){
+        num_buckets <<= 1;
+    }
+    pager->hash_mask = num_buckets - 1;
+    pager->hash_buckets = (int32_t*)malloc(sizeof(int32_t) * num_buckets);
+    for (uint32_t i = 0; i < num_buckets; i++)
+    {
+        pager->hash_buckets[i] = -1;
+    }
+
+    if(config->use_wal){
+        if(pager->use_mmap){
+            // mmap 模式下修改直接进入文件，无法保证先写日志
+            db_fail("WAL is not supported in mmap mode.");
+        }
+        wal_open(pager, filename, config);
+    }
+    else{
+        // 上次以日志模式运行后崩溃时，即使这次不用日志也要先把日志重放回数据库文件
+        char wal_filename[PATH_MAX];
+        snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+        if(access(wal_filename, F_OK) == 0){
+            if(pager->use_mmap){
+                db_fail("Database has a pending WAL; open it once without --mmap to recover.");
+            }
+            wal_open(pager, filename, config);
+            wal_close(pager);
+        }
+    }
+    return pager;
+}
+
+/**
+ * table_attach: 让 table 使用 pager，新文件写入头页和空的根叶子，已有文件校验头页
+ */
+static void table_attach(Table* table, Pager* pager){
+    table->pager = pager;
+    table->rightmost_leaf = INVALID_PAGE_NUM;
+    if(pager->num_pages == 0){
+        void* header = get_page(pager, HEADER_PAGE_NUM);
+        memset(header, 0, pager->page_size);
+        strcpy(header_magic(header), DB_HEADER_MAGIC);
+        *header_root_page(header) = HEADER_PAGE_NUM + 1;
+        *header_version(header) = DB_FORMAT_VERSION;
+        *header_page_size(header) = pager->page_size;
+        *header_page_count(header) = HEADER_PAGE_NUM + 2;
+        pager_mark_dirty(pager, HEADER_PAGE_NUM);
+        unpin_page(pager, HEADER_PAGE_NUM);
+
+        void* root_node = get_page(pager, HEADER_PAGE_NUM + 1);
+        initialize_leaf_node(pager, root_node);
+        set_node_root(root_node, true);
+        pager_mark_dirty(pager, HEADER_PAGE_NUM + 1);
+        unpin_page(pager, HEADER_PAGE_NUM + 1);
+        pager_commit(pager);
+    }
+
+    void* header = get_page(pager, HEADER_PAGE_NUM);
+    if(strncmp(header_magic(header), DB_HEADER_MAGIC, HEADER_MAGIC_SIZE) != 0){
+        db_fail("File is not a database or uses an older format.");
+    }
+    if(*header_version(header) != DB_FORMAT_VERSION){
+        // 没有版本号的旧文件不知道页大小和页数，不去猜测，与未知的版本一样拒绝
+        db_fail("Database uses format version %u, but this build only reads version %u.",
+                *header_version(header), DB_FORMAT_VERSION);
+    }
+    // 文件比记录的长: mmap 模式按块预先扩展，或者上次在提交前崩溃，多出的页不属于数据库。
+    // 文件比记录的短: 未启用日志时头页被淘汰写回后、新分配的页写出之前崩溃或磁盘满，
+    // 缺的页按新页读成全零，写回时补上；没有被树引用的页就此泄漏，但数据库仍能打开
+    pager->num_pages = *header_page_count(header);
+    table->root_page_num = *header_root_page(header);
+    table_free_indexes(table);
+    for(uint32_t i = 0; i < NUM_INDEXED_COLUMNS; i++){
+        uint32_t index_root = *header_index_root(header, i);
+        if(index_root != 0){
+            table->indexes[i] = index_open(pager, index_root);
+        }
+    }
+    unpin_page(pager, HEADER_PAGE_NUM);
+}
+
+Table* db_open(const char* filename, const PagerConfig* config){
+    Pager* pager = pager_open(filename, config);
+    Table* table = (Table*)calloc(1, sizeof(Table));
+    pthread_mutex_init(&table->writer_lock, NULL);
+    // 默认不并行扫描，由调用方（--scan-threads）按需打开
+    table->scan_threads = 1;
+    table_attach(table, pager);
+    return table;
+}
+
@@ -0,0 +1,498 @@
+/**
+ * db.h: 存储引擎内部接口
+ * 分页器、B+ 树、预写日志和语句执行都在 db.c 中，REPL（main.c）和库接口（mydb.c）共用
+ */
+#ifndef DB_H
+#define DB_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // pwritev / mremap
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <setjmp.h>
+#include <pthread.h>
+#include <time.h>
+
+#define COLUMN_USERNAME_SIZE 32 // 用户名字段长度
+#define COLUMN_EMAIL_SIZE 255   // 邮箱字段长度
+#define DEFAULT_POOL_FRAMES 256 // 缓冲池默认帧数
+#define MIN_POOL_FRAMES 16      // 缓冲池最小帧数，需容纳一次分裂同时钉住的页
+#define INVALID_PAGE_NUM UINT32_MAX
+#define HEADER_PAGE_NUM 0       // 页 0 是数据库头
+#define DEFAULT_MMAP_SIZE (1024u * 1024 * 1024) // mmap 模式默认预留的地址空间
+#define MMAP_GROW_PAGES 64      // mmap 模式下文件每次扩展的页数
+#define DEFAULT_PAGE_SIZE 4096  // 新建数据库默认的页大小
+#define MIN_PAGE_SIZE 4096
+#define MAX_PAGE_SIZE 65536     // 叶子中的偏移是 16 位，页不能更大
+#define DB_FORMAT_VERSION 2     // 头页格式版本，2 起记录页大小和页数
+#define HUGE_PAGE_SIZE (2u * 1024 * 1024) // 大页大小，缓冲池按它取整后才能用 MAP_HUGETLB 映射
+#define WAL_MAGIC 0x377f0683     // 日志文件魔数
+#define WAL_VERSION 1
+#define WAL_HEADER_SIZE 32       // 日志头: 魔数、版本、页大小、检查点序号、盐值、校验和
+#define WAL_FRAME_HEADER_SIZE 24 // 帧头: 页号、提交标记、盐值、校验和
+#define WAL_NO_FRAME UINT32_MAX
+#define DEFAULT_WAL_GROUP_COMMIT 32         // 每次 fdatasync 最多合并的提交数
+#define DEFAULT_WAL_CHECKPOINT_FRAMES 1000  // 日志达到该帧数后自动检查点
+#ifndef IOV_MAX
+#define IOV_MAX 1024            // 单次 pwritev 最多合并的页数
+#endif
+#define BULK_LOAD_DEFAULT_FILL 90   // 默认填充率（百分比）
+#define NODE_MIN_FILL_PERCENT 30    // 删除后节点的占用低于该比例时与兄弟合并或从兄弟借
+#define DB_ERROR_MESSAGE_SIZE 256
+#define MAX_TREE_DEPTH 32       // 写者下降时最多同时锁住的层数
+#define DB_MAX_HELD 1024        // 一个线程最多同时持有的锁和页引用
+#define MAX_SCAN_THREADS 64     // 并行扫描的最大线程数
+#define NUM_INDEXED_COLUMNS 2   // username、email 上各可以建一个二级索引
+#define PARALLEL_SCAN_CHUNKS_PER_THREAD 4   // 并行扫描把键空间切成线程数这么多倍的段，让快慢线程互相补位
+#define PARALLEL_SCAN_MAX_SPLIT_FACTOR 8    // 收集分段边界时最多取段数这么多倍的键
+
+// 多个线程共同累加的计数器
+#define STAT_ADD(counter, n) __atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED)
+
+/**
+ * sizeof_of_attribute: 计算结构体中某个成员的大小
+ */
+#define sizeof_of_attribute(Struct,Attribute) sizeof(((Struct*)0)->Attribute)
+
+/**
+ * Row 结构
+ * id: 主键
+ * username: 用户名
+ * email: 邮箱
+ */
+typedef struct{
+    uint32_t id;
+    char username[COLUMN_USERNAME_SIZE + 1];
+    char email[COLUMN_EMAIL_SIZE + 1];
+}Row;
+
+/**
+ * Frame 缓冲池中的一帧
+ * page_num: 帧中缓存的页号，INVALID_PAGE_NUM 表示空闲帧
+ * pin_count: 引用计数，大于 0 时不可被淘汰
+ * dirty: 是否需要写回磁盘
+ * referenced: CLOCK 算法的引用位
+ * hash_next: 同一哈希桶中的下一帧下标，-1 表示链尾
+ * data: 页数据
+ * latch: 页锁，读者加读锁、写者加写锁；只在页被钉住期间持有
+ */
+typedef struct{
+    uint32_t page_num;
+    uint32_t pin_count;
+    bool dirty;
+    bool referenced;
+    int32_t hash_next;
+    void* data;
+    pthread_rwlock_t latch;
+}Frame;
+
+/**
+ * LatchMode 页锁模式
+ * LATCH_SHARED: 读锁，多个读者可以同时持有
+ * LATCH_EXCLUSIVE: 写锁，修改页内容前必须持有
+ */
+typedef enum{
+    LATCH_SHARED,
+    LATCH_EXCLUSIVE
+}LatchMode;
+
+/**
+ * PagerConfig 分页器配置
+ * pool_frames: 缓冲池帧数，决定常驻内存的页数上限
+ * use_mmap: 是否把文件映射到内存，直接返回映射区中的页指针
+ * mmap_size: mmap 模式下预留的映射长度（字节）
+ * use_wal: 是否启用预写日志，每条修改语句提交后即可在崩溃后恢复
+ * wal_group_commit: 组提交大小，这么多次提交共享一次 fdatasync
+ * wal_checkpoint_frames: 日志帧数达到该值时自动检查点
+ * use_huge_pages: 缓冲池尽量使用大页，减少 TLB 未命中
+ * use_direct_io: 以 O_DIRECT 读写数据库文件，页只缓存在缓冲池中，不再在操作系统页缓存里再存一份
+ * page_size: 新建数据库时的页大小；已有文件使用头页中记录的页大小
+ */
+typedef struct{
+    uint32_t pool_frames;
+    bool use_mmap;
+    size_t mmap_size;
+    bool use_wal;
+    uint32_t wal_group_commit;
+    uint32_t wal_checkpoint_frames;
+    bool use_huge_pages;
+    bool use_direct_io;
+    uint32_t page_size;
+}PagerConfig;
+
+/**
+ * Wal 预写日志（数据库文件旁的 <db>-wal）
+ * 说明: 日志按帧追加整页镜像，事务最后一帧的 db_size 非零即为提交标记；
+ *      读页时先查日志索引，检查点时再把最新镜像写回数据库文件
+ * salt / checksum: 当前日志代的盐值和最后一帧的累积校验和，恢复时据此判定有效帧
+ * num_frames: 日志中的帧数，包括缓冲池溢出的未提交帧
+ * committed_frames: 最后一个提交帧之后的帧号
+ * index_pages / index_frames: 页号 -> 最新帧号 的开放寻址哈希表
+ * commits / synced_commits: 写入日志的提交数和其中已经 fdatasync 的提交数，二者之差是等待组提交落盘的提交
+ * page_size: 数据库的页大小，也是每帧页镜像的大小
+ */
+typedef struct{
+    int file_descriptor;
+    char* filename;
+    uint32_t salt[2];
+    uint32_t checksum[2];
+    uint32_t num_frames;
+    uint32_t committed_frames;
+    uint32_t* index_pages;
+    uint32_t* index_frames;
+    uint32_t index_capacity;
+    uint32_t index_count;
+    uint64_t commits;
+    uint64_t synced_commits;
+    uint32_t group_commit;
+    uint32_t checkpoint_frames;
+    uint32_t page_size;
+}Wal;
+
+/**
+ * PagerStats 分页器计数器，用于基准测试和统计
+ * pages_read: 从数据库文件或日志读入的页数
+ * pages_written: 写入数据库文件或日志的页数
+ * cache_hits / cache_misses: get_page 在缓冲池中命中/未命中的次数
+ * syncs: fsync/fdatasync 的次数
+ * 说明: mmap 模式下页的读写由操作系统完成，不计入；get_page 都算作命中
+ */
+typedef struct{
+    uint64_t pages_read;
+    uint64_t pages_written;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t syncs;
+}PagerStats;
+
+/**
+ * NodeScratch 写者分裂、合并节点时使用的临时空间，随分页器按页大小分配
+ * 说明: 页最大 64KB，这些数组放在栈上时递归的分裂会用掉很多栈。只有持有写者锁的线程使用；
+ *      分裂向上传递到父节点之前，下一层已经用完了它
+ * pages: 两页，保存要重写的叶子原来的内容
+ * defragment_page: 整理叶子碎片时保存原来的内容（分裂、合并中写入的都是新叶子，不会整理碎片）
+ * cells / sizes: 两个叶子合起来的单元格及其大小
+ * children / keys: 两个内部节点合起来的孩子及其键
+ */
+typedef struct{
+    uint8_t* pages;
+    uint8_t* defragment_page;
+    void** cells;
+    uint32_t* sizes;
+    uint32_t* children;
+    uint32_t* keys;
+}NodeScratch;
+
+/**
+ * Pager 结构
+ * filename: 数据库文件名
+ * config: 打开时使用的配置
+ * file_descriptor: 文件描述符
+ * file_length: 文件长度
+ * num_pages: 数据库的总页数
+ * page_size: 页大小，建库时选定并记录在头页中；同一进程可以同时打开页大小不同的数据库
+ * leaf_node_space_for_cells: 叶子节点中键数组之后可用于单元格的空间
+ * leaf_node_max_cells: 叶子节点最大单元数（全是最短行时）
+ * internal_node_max_keys: 内部节点容量
+ * freelist_trunk_max_leaves: 一个主干页能记录的空闲页数
+ * scratch: 写者重排节点用的临时空间
+ * frames: 缓冲池帧数组
+ * frame_arena / frame_arena_size: 所有帧的页数据所在的一整块按页对齐的内存
+ * frame_arena_huge: frame_arena 是否由 MAP_HUGETLB 大页映射
+ * num_frames: 缓冲池帧数
+ * hash_buckets: 页号 -> 帧下标 的哈希表（拉链法）
+ * hash_mask: 哈希桶数 - 1
+ * clock_hand: CLOCK 淘汰指针
+ * use_mmap: 是否为 mmap 模式，此时不使用缓冲池
+ * map: 文件映射的起始地址
+ * map_size: 映射区长度，可能大于文件长度
+ * map_pins: mmap 模式下被钉住的页总数，非零时映射区不能移动
+ * wal: 预写日志，未启用时为 NULL
+ * stats: 读写计数
+ * mutex: 缓冲池互斥锁（可重入），保护哈希表、CLOCK、钉住计数、脏标记、日志和读写计数；
+ *        持有它时不能再去等页锁
+ */
+typedef struct{
+    char* filename;
+    PagerConfig config;
+    int file_descriptor;
+    off_t file_length;
+    uint32_t num_pages;
+    uint32_t page_size;
+    uint32_t leaf_node_space_for_cells;
+    uint32_t leaf_node_max_cells;
+    uint32_t internal_node_max_keys;
+    uint32_t freelist_trunk_max_leaves;
+    NodeScratch scratch;
+    Frame* frames;
+    void* frame_arena;
+    size_t frame_arena_size;
+    bool frame_arena_huge;
+    uint32_t num_frames;
+    int32_t* hash_buckets;
+    uint32_t hash_mask;
+    uint32_t clock_hand;
+    bool use_mmap;
+    void* map;
+    size_t map_size;
+    uint32_t map_pins;
+    Wal* wal;
+    PagerStats stats;
+    pthread_mutex_t mutex;
+}Pager;
+
+/**
+ * PrepareResult 准备结果类型
+ * PREPARE_SUCCESS: 准备成功
+ * PREPARE_UNRECOGNIZED_STATEMENT: 未识别的语句
+ * PREPARE_SYNTAX_ERROR: 语法错误
+ */
+typedef enum{
+    PREPARE_SUCCESS,
+    PREPARE_UNRECOGNIZED_STATEMENT,
+    PREPARE_SYNTAX_ERROR,
+    PREPARE_STRING_TOO_LONG,
+    PREPARE_NEGATIVE_ID,
+}PrepareResult;
+
+/**
+ * StatementType 语句类型
+ * STATEMENT_INSERT: 插入语句
+ * STATEMENT_SELECT: 查询语句
+ * STATEMENT_CREATE_INDEX: 建索引语句
+ * STATEMENT_DELETE: 删除语句
+ */
+typedef enum { 
+    STATEMENT_INSERT,
+    STATEMENT_SELECT,
+    STATEMENT_CREATE_INDEX,
+    STATEMENT_DELETE
+}StatementType;
+
+/**
+ * Column 列编号
+ */
+typedef enum{
+    COLUMN_ID,
+    COLUMN_USERNAME,
+    COLUMN_EMAIL
+}Column;
+
+#define MAX_PROJECTED_COLUMNS 8
+#define MAX_PREDICATES 4
+
+/**
+ * PredicateOperator 字符串列上的比较方式
+ * PREDICATE_EQUAL: 相等
+ * PREDICATE_PREFIX: 前缀匹配（like 'abc%'）
+ */
+typedef enum{
+    PREDICATE_EQUAL,
+    PREDICATE_PREFIX
+}PredicateOperator;
+
+/**
+ * Predicate 字符串列上的一个条件
+ * column: COLUMN_USERNAME 或 COLUMN_EMAIL
+ * value / value_length: 要比较的值（前缀匹配时不含 %）
+ */
+typedef struct{
+    Column column;
+    PredicateOperator op;
+    char value[COLUMN_EMAIL_SIZE + 1];
+    uint32_t value_length;
+}Predicate;
+
+/**
+ * Statement 语句结构
+ * type: 语句类型
+ * id_to_insert: 要插入的行的 id
+ * cell_to_insert / cell_to_insert_size: 要插入的行，解析时直接写成序列化格式（不会超过 Row 的大小）
+ * has_id_range: 查询/删除是否限定了 id 范围
+ * id_start / id_end: id 范围的上下界（都包含）
+ * projection / num_projected: 按输出顺序排列的列
+ * predicates: 字符串列上的条件，全部满足的行才输出或删除
+ * count_only: select count(*)，只输出满足条件的行数
+ * index_column: create index 的列
+ * rows_deleted: 执行 delete 后删除的行数
+ */
+typedef struct {
+  StatementType type;
+  uint32_t id_to_insert;
+  uint8_t cell_to_insert[sizeof(Row)];
+  uint32_t cell_to_insert_size;
+  bool has_id_range;
+  uint32_t id_start;
+  uint32_t id_end;
+  Column projection[MAX_PROJECTED_COLUMNS];
+  uint32_t num_projected;
+  uint32_t num_predicates;
+  Predicate predicates[MAX_PREDICATES];
+  bool count_only;
+  Column index_column;
+  uint64_t rows_deleted;
+} Statement;
+
+/**
+ * TableStats B+ 树和语句的计数器
+ * leaf_splits / internal_splits: 叶子节点、内部节点的分裂次数
+ * fast_appends: 不从根下降、直接追加到缓存的最右叶子的插入次数
+ * merges / borrows: 删除后过空的节点与兄弟合并（包括根降低一层）、从兄弟借单元格的次数
+ * cursors_opened / cursor_advances: 创建游标和游标前移的次数
+ * statements / statement_ns: 执行的语句数及总耗时（纳秒）
+ */
+typedef struct{
+    uint64_t leaf_splits;
+    uint64_t internal_splits;
+    uint64_t fast_appends;
+    uint64_t merges;
+    uint64_t borrows;
+    uint64_t cursors_opened;
+    uint64_t cursor_advances;
+    uint64_t statements;
+    uint64_t statement_ns;
+}TableStats;
+
+/**
+ * Table 一棵 B+ 树（表本身或者它的一个索引），行都存放在叶子中
+ */
+typedef struct Table{
+    Pager* pager;       // 分页器
+    uint32_t root_page_num; // 根页号
+    TableStats stats;   // 计数器
+    pthread_mutex_t writer_lock;    // 同一时间只允许一个写者
+    uint32_t scan_threads;  // 查询扫描使用的线程数，1 表示不并行
+    struct Table* indexes[NUM_INDEXED_COLUMNS]; // username、email 上的索引树，没有索引时为 NULL
+    uint32_t rightmost_leaf;    // 缓存的最右叶子页号，INVALID_PAGE_NUM 表示未知；只在持有 writer_lock 时读写
+}Table;
+
+typedef enum { 
+    EXECUTE_SUCCESS,
+    EXECUTE_TABLE_FULL, 
+    EXECUTE_UNRECOGNIZED_STATEMENT,
+    EXECUTE_DUPLICATE_KEY,
+    EXECUTE_TABLE_NOT_EMPTY,
+    EXECUTE_INDEX_EXISTS
+}ExecuteResult;
+
+/**
+ * 游标结构
+ * table: 表指针
+ * page_num / cell_num: 所在叶子的页号及叶子中的单元格下标
+ * end_of_table: 是否到达表尾
+ * node: 所在叶子的页指针，游标钉住该页并持有它的页锁
+ * latch: 叶子上的页锁模式，读游标为读锁，插入游标为写锁
+ * ancestors / num_ancestors: 插入游标还锁着的祖先节点（自顶向下），分裂时会修改它们
+ * advances: 尚未累加到表计数器中的前移次数
+ */
+typedef struct{
+    Table* table;
+    uint32_t page_num;
+    uint32_t cell_num;
+    bool end_of_table;
+    void* node;
+    LatchMode latch;
+    uint32_t ancestors[MAX_TREE_DEPTH];
+    uint32_t num_ancestors;
+    uint64_t advances;
+}Cursor;
+
+/**
+ * RowView 直接指向页中已序列化的行，不做任何拷贝
+ * 字符串不以 '\0' 结尾，必须配合长度使用
+ */
+typedef struct{
+    uint32_t id;
+    const char* username;
+    uint32_t username_length;
+    const char* email;
+    uint32_t email_length;
+}RowView;
+
+/**
+ * RowSource 行数据源
+ * next: 按键严格递增的顺序产出下一行，没有更多行时返回 false
+ * context: 传给 next 的上下文
+ */
+typedef struct{
+    bool (*next)(void* context, Row* row);
+    void* context;
+}RowSource;
+
+/**
+ * 引擎错误处理
+ * 说明: 库接口调用期间 db_error_jump 指向调用方的 jmp_buf，db_fail 把消息写入 db_error_message 后跳回；
+ *      没有设置跳转点时（REPL）打印消息并退出进程。
+ *      每个线程记录自己持有的缓冲池锁、写者锁、页引用和页锁：跳转点设置时先 db_held_mark 记下位置，
+ *      跳回后 db_release_held 放开此后取得的全部资源，正常返回时 db_forget_held 丢掉记录
+ */
+extern __thread jmp_buf* db_error_jump;
+extern __thread char db_error_message[DB_ERROR_MESSAGE_SIZE];
+void db_fail(const char* format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+uint32_t db_held_mark(void);
+void db_release_held(uint32_t mark);
+void db_forget_held(uint32_t mark);
+void db_mutex_lock(pthread_mutex_t* mutex);
+void db_mutex_unlock(pthread_mutex_t* mutex);
+
+// 分页器
+void pager_config_init(PagerConfig* config);
+Pager* pager_open(const char* filename, const PagerConfig* config);
+void pager_close(Pager* pager);
+void* get_page(Pager* pager, uint32_t page_num);
+void pager_mark_dirty(Pager* pager, uint32_t page_num);
+void unpin_page(Pager* pager, uint32_t page_num);
+void* get_page_latched(Pager* pager, uint32_t page_num, LatchMode mode);
+void release_page(Pager* pager, uint32_t page_num);
+void pager_commit(Pager* pager);
+void pager_sync(Pager* pager);
+bool pager_has_unsynced_commits(Pager* pager);
+void wal_checkpoint(Pager* pager);
+void pager_checkpoint(Pager* pager);
+
+// 表与游标
+Table* db_open(const char* filename, const PagerConfig* config);
+void db_close(Table* table);
+void table_find(Table* table, uint32_t key, Cursor* cursor);
+void table_seek(Table* table, uint32_t key, Cursor* cursor);
+void table_start(Table* table, Cursor* cursor);
+void* cursor_value(Cursor* cursor);
+void cursor_advance(Cursor* cursor);
+void cursor_close(Cursor* cursor);
+void row_view_init(void* source, RowView* view);
+void deserialize_row(void* source, Row* destination);
+uint32_t stored_row_size(void* source);
+ExecuteResult table_bulk_load(Table* table, RowSource* source, uint32_t fill_percent);
+uint64_t table_delete(Table* table, uint32_t start, uint32_t end, Predicate* predicates, uint32_t num_predicates);
+void table_checkpoint(Table* table);
+void table_vacuum(Table* table);
+void print_tree(Pager* pager, uint32_t page_num, uint32_t indentation_level);
+void print_constants(Pager* pager);
+void print_stats(Table* table);
+void stats_reset(Table* table);
+
+// 语句
+PrepareResult prepare_statement(const char* input, Statement* statement);
+PrepareResult prepare_row(const char* input, Row* row);
+void statement_set_insert_row(Statement* statement, uint32_t id, const char* username, uint32_t username_length,
+                              const char* email, uint32_t email_length);
+ExecuteResult execute_insert(Statement* statement, Table* table);
+ExecuteResult execute_statement(Statement* statement, Table* table);
+
+#endif
@@ -0,0 +1,540 @@
+/**
+ * mydb.c: 库接口的实现，把 mydb.h 中的调用转到 db.c 中的引擎上
+ */
+#include "db.h"
+#include "mydb.h"
+
+/**
+ * MydbShared 进程内打开同一个数据库文件的所有句柄共享的引擎
+ * path: 数据库文件的绝对路径
+ * table: 打开的表
+ * num_handles: 引用它的句柄数，最后一个句柄关闭时才关闭引擎
+ * failed: 引擎出过错，所有句柄都只允许关闭
+ */
+typedef struct MydbShared{
+    char* path;
+    Table* table;
+    uint32_t num_handles;
+    bool failed;
+    struct MydbShared* next;
+}MydbShared;
+
+// 已打开的引擎链表
+MydbShared* shared_engines = NULL;
+pthread_mutex_t shared_engines_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * mydb 数据库句柄
+ * shared / table: 共享的引擎及其表
+ * row_buffer: mydb_get 把行拷贝到这里后立即放开页锁，返回的指针指向它
+ * num_iterators: 尚未关闭的扫描迭代器数
+ * failed: 引擎出过错，之后只允许关闭
+ * error_message: 最近一次错误的说明
+ */
+struct mydb{
+    MydbShared* shared;
+    Table* table;
+    uint8_t row_buffer[sizeof(Row)];
+    uint32_t num_iterators;
+    bool failed;
+    char error_message[DB_ERROR_MESSAGE_SIZE];
+};
+
+/**
+ * mydb_stmt 预编译的插入语句，绑定的字符串会被拷贝
+ */
+struct mydb_stmt{
+    mydb* db;
+    Statement statement;
+    uint32_t id;
+    char username[COLUMN_USERNAME_SIZE];
+    uint32_t username_length;
+    char email[COLUMN_EMAIL_SIZE];
+    uint32_t email_length;
+    bool id_bound;
+    bool username_bound;
+    bool email_bound;
+};
+
+/**
+ * mydb_iter 扫描迭代器
+ * 说明: 两次调用之间不持有页锁；缓冲的行用完后从 next_id 重新定位，
+ *      把所在叶子中剩下的行一次拷贝出来，返回的指针在下一次调用之前有效
+ * next_id: 下一次重新定位的起点，即已缓冲的最后一行的 id + 1
+ * end_id: 扫描的上界（包含）
+ * rows / row_offsets: 缓冲的行及每行在 rows 中的偏移，rows 的大小为一页
+ * num_rows / position: 缓冲的行数和下一次返回的行
+ * exhausted: 范围内的行都已缓冲过，缓冲区用完即结束
+ */
+struct mydb_iter{
+    mydb* db;
+    uint32_t next_id;
+    uint32_t end_id;
+    uint8_t* rows;
+    uint32_t* row_offsets;
+    uint32_t num_rows;
+    uint32_t position;
+    bool exhausted;
+};
+
+/*
+    进入引擎前设置跳转点，引擎调用 db_fail 时回到这里，放开本次调用取得的锁和页，句柄标记为出错并返回 MYDB_ERROR。
+    setjmp 必须在仍然存活的栈帧中调用，所以写成宏；每个返回路径都要先 MYDB_LEAVE
+*/
+#define MYDB_ENTER(db) \
+    jmp_buf jump; \
+    uint32_t held_mark = db_held_mark(); \
+    if((db)->failed || (db)->shared->failed){ \
+        return MYDB_ERROR; \
+    } \
+    if(setjmp(jump) != 0){ \
+        db_release_held(held_mark); \
+        return mydb_engine_failed(db); \
+    } \
+    db_error_jump = &jump
+
+#define MYDB_LEAVE() (db_forget_held(held_mark), db_error_jump = NULL)
+
+/**
+ * mydb_engine_failed: 从引擎错误中跳回后记录错误
+ */
+static int mydb_engine_failed(mydb* db){
+    db_error_jump = NULL;
+    db->failed = true;
+    db->shared->failed = true;
+    snprintf(db->error_message, sizeof(db->error_message), "%s", db_error_message);
+    return MYDB_ERROR;
+}
+
+static int mydb_misuse(mydb* db, const char* message){
+    snprintf(db->error_message, sizeof(db->error_message), "%s", message);
+    return MYDB_MISUSE;
+}
+
+static void mydb_fill_row(void* source, mydb_row* row){
+    RowView view;
+    row_view_init(source, &view);
+    row->id = view.id;
+    row->username = view.username;
+    row->username_length = view.username_length;
+    row->email = view.email;
+    row->email_length = view.email_length;
+}
+
+void mydb_options_init(mydb_options* options){
+    PagerConfig config;
+    pager_config_init(&config);
+    options->pool_frames = config.pool_frames;
+    options->use_wal = config.use_wal;
+    options->wal_group_commit = config.wal_group_commit;
+    options->use_mmap = config.use_mmap;
+    options->mmap_size = config.mmap_size;
+    options->use_huge_pages = config.use_huge_pages;
+    options->use_direct_io = config.use_direct_io;
+    options->page_size = config.page_size;
+}
+
+/**
+ * mydb_attach: 找到已经打开的同一文件的引擎，或者打开一个新的
+ * 说明: 调用方持有 shared_engines_mutex；引擎出错时 db_fail 会跳回 mydb_open
+ */
+static int mydb_attach(mydb* db, const char* filename, const PagerConfig* config){
+    char* path = realpath(filename, NULL);
+    for(MydbShared* shared = shared_engines; path != NULL && shared != NULL; shared = shared->next){
+        if(strcmp(shared->path, path) == 0){
+            free(path);
+            if(shared->failed){
+                return MYDB_ERROR;
+            }
+            // mmap 模式没有页锁，不能在句柄之间共享
+            if(config->use_mmap || shared->table->pager->use_mmap){
+                return mydb_misuse(db, "A database in mmap mode can only be opened by one handle.");
+            }
+            shared->num_handles++;
+            db->shared = shared;
+            db->table = shared->table;
+            return MYDB_OK;
+        }
+    }
+    free(path);
+
+    Table* table = db_open(filename, config);
+    MydbShared* shared = (MydbShared*)calloc(1, sizeof(MydbShared));
+    shared->path = realpath(filename, NULL);
+    shared->table = table;
+    shared->num_handles = 1;
+    shared->next = shared_engines;
+    shared_engines = shared;
+    db->shared = shared;
+    db->table = table;
+    return MYDB_OK;
+}
+
+/**
+ * mydb_detach: 句柄不再引用引擎，最后一个句柄负责关闭引擎
+ * 返回值: 引擎已经出过错时为 true，此时不再关闭表，只释放内存
+ */
+static bool mydb_detach(MydbShared* shared){
+    if(--shared->num_handles > 0){
+        return false;
+    }
+    MydbShared** link = &shared_engines;
+    while(*link != shared){
+        link = &(*link)->next;
+    }
+    *link = shared->next;
+    bool failed = shared->failed;
+    if(!failed){
+        db_close(shared->table);
+    }
+    free(shared->path);
+    free(shared);
+    return failed;
+}
+
+int mydb_open(const char* filename, const mydb_options* options, mydb** db){
+    mydb* handle = (mydb*)calloc(1, sizeof(mydb));
+    *db = handle;
+
+    PagerConfig config;
+    pager_config_init(&config);
+    if(options != NULL){
+        config.pool_frames = options->pool_frames;
+        config.use_wal = options->use_wal;
+        config.wal_group_commit = options->wal_group_commit;
+        config.use_mmap = options->use_mmap;
+        config.mmap_size = options->mmap_size;
+        config.use_huge_pages = options->use_huge_pages;
+        config.use_direct_io = options->use_direct_io;
+        config.page_size = options->page_size;
+    }
+
+    pthread_mutex_lock(&shared_engines_mutex);
+    jmp_buf jump;
+    uint32_t held_mark = db_held_mark();
+    if(setjmp(jump) != 0){
+        db_error_jump = NULL;
+        db_release_held(held_mark);
+        pthread_mutex_unlock(&shared_engines_mutex);
+        handle->failed = true;
+        snprintf(handle->error_message, sizeof(handle->error_message), "%s", db_error_message);
+        return MYDB_ERROR;
+    }
+    db_error_jump = &jump;
+    int result = mydb_attach(handle, filename, &config);
+    db_error_jump = NULL;
+    db_forget_held(held_mark);
+    pthread_mutex_unlock(&shared_engines_mutex);
+    if(result == MYDB_ERROR){
+        handle->failed = true;
+        snprintf(handle->error_message, sizeof(handle->error_message), "Database was closed after an earlier error.");
+    }
+    return result;
+}
+
+int mydb_close(mydb* db){
+    if(db == NULL){
+        return MYDB_OK;
+    }
+    if(db->num_iterators > 0){
+        return mydb_misuse(db, "Close all iterators before closing the database.");
+    }
+    if(db->shared == NULL){
+        // 打开失败的句柄
+        free(db);
+        return MYDB_ERROR;
+    }
+
+    int result = db->failed ? MYDB_ERROR : MYDB_OK;
+    pthread_mutex_lock(&shared_engines_mutex);
+    jmp_buf jump;
+    uint32_t held_mark = db_held_mark();
+    if(setjmp(jump) != 0){
+        // 关闭时出错，数据库文件保持最后一次提交的样子
+        db_error_jump = NULL;
+        db_release_held(held_mark);
+        result = MYDB_ERROR;
+    }
+    else{
+        db_error_jump = &jump;
+        if(mydb_detach(db->shared)){
+            result = MYDB_ERROR;
+        }
+        db_error_jump = NULL;
+        db_forget_held(held_mark);
+    }
+    pthread_mutex_unlock(&shared_engines_mutex);
+    free(db);
+    return result;
+}
+
+const char* mydb_errmsg(mydb* db){
+    return db->error_message;
+}
+
+int mydb_prepare_insert(mydb* db, mydb_stmt** stmt){
+    mydb_stmt* handle = (mydb_stmt*)calloc(1, sizeof(mydb_stmt));
+    handle->db = db;
+    *stmt = handle;
+    return MYDB_OK;
+}
+
+int mydb_bind_id(mydb_stmt* stmt, uint32_t id){
+    stmt->id = id;
+    stmt->id_bound = true;
+    return MYDB_OK;
+}
+
+int mydb_bind_username(mydb_stmt* stmt, const char* username, uint32_t length){
+    if(length > COLUMN_USERNAME_SIZE){
+        return MYDB_TOO_LONG;
+    }
+    memcpy(stmt->username, username, length);
+    stmt->username_length = length;
+    stmt->username_bound = true;
+    return MYDB_OK;
+}
+
+int mydb_bind_email(mydb_stmt* stmt, const char* email, uint32_t length){
+    if(length > COLUMN_EMAIL_SIZE){
+        return MYDB_TOO_LONG;
+    }
+    memcpy(stmt->email, email, length);
+    stmt->email_length = length;
+    stmt->email_bound = true;
+    return MYDB_OK;
+}
+
+int mydb_step(mydb_stmt* stmt){
+    mydb* db = stmt->db;
+    if(!stmt->id_bound || !stmt->username_bound || !stmt->email_bound){
+        return mydb_misuse(db, "All parameters must be bound before mydb_step.");
+    }
+
+    if(db->num_iterators > 0){
+        // 迭代器持有叶子的读锁，同一线程再去写会等自己放锁
+        return mydb_misuse(db, "Close all iterators on this handle before inserting.");
+    }
+
+    MYDB_ENTER(db);
+    statement_set_insert_row(&stmt->statement, stmt->id, stmt->username, stmt->username_length,
+                             stmt->email, stmt->email_length);
+    ExecuteResult result = execute_insert(&stmt->statement, db->table);
+    MYDB_LEAVE();
+    if(result == EXECUTE_DUPLICATE_KEY){
+        return MYDB_DUPLICATE_KEY;
+    }
+    return pager_has_unsynced_commits(db->table->pager) ? MYDB_PENDING : MYDB_OK;
+}
+
+int mydb_reset(mydb_stmt* stmt){
+    stmt->id_bound = false;
+    stmt->username_bound = false;
+    stmt->email_bound = false;
+    return MYDB_OK;
+}
+
+int mydb_finalize(mydb_stmt* stmt){
+    free(stmt);
+    return MYDB_OK;
+}
+
+/**
+ * MydbRowSource 把调用方的 mydb_row 数组作为批量加载的数据源
+ */
+typedef struct{
+    const mydb_row* rows;
+    uint32_t num_rows;
+    uint32_t next_index;
+}MydbRowSource;
+
+static bool mydb_row_source_next(void* context, Row* row){
+    MydbRowSource* source = (MydbRowSource*)context;
+    if(source->next_index >= source->num_rows){
+        return false;
+    }
+    const mydb_row* next = &source->rows[source->next_index++];
+    row->id = next->id;
+    memcpy(row->username, next->username, next->username_length);
+    row->username[next->username_length] = '\0';
+    memcpy(row->email, next->email, next->email_length);
+    row->email[next->email_length] = '\0';
+    return true;
+}
+
+int mydb_bulk_load(mydb* db, const mydb_row* rows, uint32_t num_rows, uint32_t fill_percent){
+    if(fill_percent == 0 || fill_percent > 100){
+        return mydb_misuse(db, "Fill percent must be between 1 and 100.");
+    }
+    if(db->num_iterators > 0){
+        return mydb_misuse(db, "Close all iterators on this handle before bulk loading.");
+    }
+    // 先检查全部行，不合格的输入不会写下任何页
+    for(uint32_t i = 0; i < num_rows; i++){
+        if(rows[i].username_length > COLUMN_USERNAME_SIZE || rows[i].email_length > COLUMN_EMAIL_SIZE){
+            return MYDB_TOO_LONG;
+        }
+        if(i > 0 && rows[i].id <= rows[i - 1].id){
+            return MYDB_DUPLICATE_KEY;
+        }
+    }
+
+    MYDB_ENTER(db);
+    MydbRowSource source = {rows, num_rows, 0};
+    RowSource row_source = {mydb_row_source_next, &source};
+    ExecuteResult result = table_bulk_load(db->table, &row_source, fill_percent);
+    pager_sync(db->table->pager);
+    MYDB_LEAVE();
+    if(result == EXECUTE_TABLE_NOT_EMPTY){
+        return mydb_misuse(db, "Bulk load requires an empty table.");
+    }
+    return result == EXECUTE_DUPLICATE_KEY ? MYDB_DUPLICATE_KEY : MYDB_OK;
+}
+
+int mydb_get(mydb* db, uint32_t id, mydb_row* row){
+    MYDB_ENTER(db);
+    Cursor cursor;
+    table_seek(db->table, id, &cursor);
+    int result = MYDB_NOT_FOUND;
+    if(!cursor.end_of_table && *(uint32_t*)cursor_value(&cursor) == id){
+        // 行拷贝到句柄中后立即放开页锁，不会因为调用方持有结果而挡住写者
+        void* value = cursor_value(&cursor);
+        memcpy(db->row_buffer, value, stored_row_size(value));
+        mydb_fill_row(db->row_buffer, row);
+        result = MYDB_OK;
+    }
+    cursor_close(&cursor);
+    MYDB_LEAVE();
+    return result;
+}
+
+int mydb_delete_range(mydb* db, uint32_t start_id, uint32_t end_id, uint64_t* deleted){
+    if(db->num_iterators > 0){
+        return mydb_misuse(db, "Close all iterators on this handle before deleting.");
+    }
+
+    MYDB_ENTER(db);
+    uint64_t count = table_delete(db->table, start_id, end_id, NULL, 0);
+    MYDB_LEAVE();
+    if(deleted != NULL){
+        *deleted = count;
+    }
+    return pager_has_unsynced_commits(db->table->pager) ? MYDB_PENDING : MYDB_OK;
+}
+
+int mydb_scan_open(mydb* db, uint32_t start_id, uint32_t end_id, mydb_iter** iter){
+    MYDB_ENTER(db);
+    Pager* pager = db->table->pager;
+    mydb_iter* handle = (mydb_iter*)malloc(sizeof(mydb_iter));
+    handle->db = db;
+    handle->next_id = start_id;
+    handle->end_id = end_id;
+    handle->rows = (uint8_t*)malloc(pager->page_size);
+    handle->row_offsets = (uint32_t*)malloc(sizeof(uint32_t) * pager->leaf_node_max_cells);
+    handle->num_rows = 0;
+    handle->position = 0;
+    handle->exhausted = start_id > end_id;
+    db->num_iterators++;
+    *iter = handle;
+    MYDB_LEAVE();
+    return MYDB_OK;
+}
+
+/**
+ * mydb_iter_fill: 从 next_id 重新定位，把所在叶子中不超过 end_id 的行拷贝到迭代器中
+ * 说明: 拷贝完立即放开页锁，调用方在两次 mydb_scan_next 之间做什么都不会挡住写者；
+ *      游标前移到下一个叶子时停下，那个叶子留到下一次重新定位
+ */
+static void mydb_iter_fill(mydb_iter* iter){
+    Cursor cursor;
+    table_seek(iter->db->table, iter->next_id, &cursor);
+    uint32_t page_num = cursor.page_num;
+    uint32_t used = 0;
+    iter->num_rows = 0;
+    iter->position = 0;
+    iter->exhausted = true;
+    while(!cursor.end_of_table && cursor.page_num == page_num){
+        void* value = cursor_value(&cursor);
+        uint32_t id = *(uint32_t*)value;
+        if(id > iter->end_id){
+            break;
+        }
+        uint32_t size = stored_row_size(value);
+        memcpy(iter->rows + used, value, size);
+        iter->row_offsets[iter->num_rows++] = used;
+        used += size;
+        // id 已经到了上界，后面不会再有范围内的行
+        iter->exhausted = id == iter->end_id;
+        iter->next_id = id + 1;
+        cursor_advance(&cursor);
+    }
+    if(cursor.end_of_table){
+        iter->exhausted = true;
+    }
+    cursor_close(&cursor);
+}
+
+int mydb_scan_next(mydb_iter* iter, mydb_row* row){
+    mydb* db = iter->db;
+    MYDB_ENTER(db);
+    if(iter->position == iter->num_rows && !iter->exhausted){
+        mydb_iter_fill(iter);
+    }
+    int result = MYDB_DONE;
+    if(iter->position < iter->num_rows){
+        mydb_fill_row(iter->rows + iter->row_offsets[iter->position++], row);
+        result = MYDB_ROW;
+    }
+    MYDB_LEAVE();
+    return result;
+}
+
+void mydb_scan_close(mydb_iter* iter){
+    if(iter == NULL){
+        return;
+    }
+    iter->db->num_iterators--;
+    free(iter->rows);
+    free(iter->row_offsets);
+    free(iter);
+}
+
+int mydb_sync(mydb* db){
+    MYDB_ENTER(db);
+    pager_sync(db->table->pager);
+    MYDB_LEAVE();
+    return MYDB_OK;
+}
+
+int mydb_checkpoint(mydb* db){
+    MYDB_ENTER(db);
+    table_checkpoint(db->table);
+    MYDB_LEAVE();
+    return MYDB_OK;
+}
+
+int mydb_stats_get(mydb* db, mydb_stats* stats){
+    if(db->failed || db->shared->failed){
+        return MYDB_ERROR;
+    }
+    Pager* pager = db->table->pager;
+    pthread_mutex_lock(&pager->mutex);
+    stats->pages_read = pager->stats.pages_read;
+    stats->pages_written = pager->stats.pages_written;
+    stats->cache_hits = pager->stats.cache_hits;
+    stats->cache_misses = pager->stats.cache_misses;
+    stats->syncs = pager->stats.syncs;
+    stats->page_count = pager->num_pages;
+    stats->page_size = pager->page_size;
+    pthread_mutex_unlock(&pager->mutex);
+    return MYDB_OK;
+}
+
+void mydb_stats_reset(mydb* db){
+    if(!db->failed && !db->shared->failed){
+        Pager* pager = db->table->pager;
+        pthread_mutex_lock(&pager->mutex);
+        memset(&pager->stats, 0, sizeof(PagerStats));
+        pthread_mutex_unlock(&pager->mutex);
+    }
+}
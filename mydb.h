@@ -0,0 +1,143 @@
+/**
+ * mydb.h: 可嵌入的数据库库接口（libmydb）
+ * 说明: 直接在进程内读写数据库，不经过文本解析和打印；
+ *      所有函数返回错误码，不会调用 exit()，出错信息由 mydb_errmsg 取得。
+ *      同一个句柄不能同时被多个线程使用；多个线程各自 mydb_open 同一个文件时共享一个引擎，
+ *      读操作可以并行，写操作互斥（后打开的句柄沿用第一个句柄的选项，mmap 模式不支持共享）。
+ *      扫描迭代器在两次 mydb_scan_next 之间不持有页锁，每次从上一次返回的 id 之后重新定位，
+ *      期间其他线程的修改可能看到也可能看不到；句柄上还有未关闭的迭代器时不能通过它写入
+ */
+#ifndef MYDB_H
+#define MYDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define MYDB_USERNAME_MAX 32   // 用户名最大长度
+#define MYDB_EMAIL_MAX 255     // 邮箱最大长度
+
+/**
+ * 错误码
+ * MYDB_OK: 成功
+ * MYDB_ROW: 扫描产出了一行
+ * MYDB_DONE: 扫描结束
+ * MYDB_NOT_FOUND: 没有该 id 的行
+ * MYDB_DUPLICATE_KEY: id 已存在
+ * MYDB_TOO_LONG: 字符串超过列宽
+ * MYDB_MISUSE: 参数或调用顺序不正确
+ * MYDB_ERROR: 文件读写等引擎错误，之后只能调用 mydb_close
+ * MYDB_PENDING: 修改已提交、其他读者可见，但还在等组提交的 fdatasync，崩溃时可能丢失；
+ *               凑满 wal_group_commit 个提交或调用 mydb_sync 之后才落盘
+ */
+enum{
+    MYDB_OK = 0,
+    MYDB_ROW,
+    MYDB_DONE,
+    MYDB_NOT_FOUND,
+    MYDB_DUPLICATE_KEY,
+    MYDB_TOO_LONG,
+    MYDB_MISUSE,
+    MYDB_ERROR,
+    MYDB_PENDING
+};
+
+typedef struct mydb mydb;
+typedef struct mydb_stmt mydb_stmt;
+typedef struct mydb_iter mydb_iter;
+
+/**
+ * mydb_options 打开选项，先用 mydb_options_init 填充默认值
+ * pool_frames: 缓冲池帧数
+ * use_wal / wal_group_commit: 预写日志及组提交大小
+ * use_mmap / mmap_size: mmap 模式及预留的映射长度（字节）
+ * use_huge_pages: 缓冲池尽量使用大页
+ * use_direct_io: 以 O_DIRECT 读写数据库文件，不经过操作系统页缓存（不能与 mmap 同时使用）
+ * page_size: 新建数据库的页大小（4096 到 65536 之间的 2 的幂），已有数据库沿用建库时的页大小
+ */
+typedef struct{
+    uint32_t pool_frames;
+    bool use_wal;
+    uint32_t wal_group_commit;
+    bool use_mmap;
+    size_t mmap_size;
+    bool use_huge_pages;
+    bool use_direct_io;
+    uint32_t page_size;
+}mydb_options;
+
+/**
+ * mydb_row 一行数据
+ * 字符串直接指向页中的数据，不以 '\0' 结尾，必须配合长度使用；
+ * 在同一句柄（或迭代器）上的下一次调用之前有效
+ */
+typedef struct{
+    uint32_t id;
+    const char* username;
+    uint32_t username_length;
+    const char* email;
+    uint32_t email_length;
+}mydb_row;
+
+/**
+ * mydb_stats 读写计数，从打开（或上一次 mydb_stats_reset）开始累计
+ * pages_read / pages_written: 从文件或日志读入、写入的页数（mmap 模式下不计）
+ * cache_hits / cache_misses: 缓冲池命中/未命中次数
+ * syncs: fsync/fdatasync 次数
+ * page_count: 数据库当前的页数
+ * page_size: 页大小（字节）
+ */
+typedef struct{
+    uint64_t pages_read;
+    uint64_t pages_written;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t syncs;
+    uint32_t page_count;
+    uint32_t page_size;
+}mydb_stats;
+
+void mydb_options_init(mydb_options* options);
+
+// 打开/关闭数据库，options 为 NULL 时使用默认选项
+int mydb_open(const char* filename, const mydb_options* options, mydb** db);
+int mydb_close(mydb* db);
+const char* mydb_errmsg(mydb* db);
+
+// 预编译插入: 绑定参数后 mydb_step 执行，mydb_reset 后可重新绑定；句柄上有打开的迭代器时返回 MYDB_MISUSE；
+// 启用日志且 wal_group_commit 大于 1 时，插入可能还没有落盘，此时返回 MYDB_PENDING 而不是 MYDB_OK
+int mydb_prepare_insert(mydb* db, mydb_stmt** stmt);
+int mydb_bind_id(mydb_stmt* stmt, uint32_t id);
+int mydb_bind_username(mydb_stmt* stmt, const char* username, uint32_t length);
+int mydb_bind_email(mydb_stmt* stmt, const char* email, uint32_t length);
+int mydb_step(mydb_stmt* stmt);
+int mydb_reset(mydb_stmt* stmt);
+int mydb_finalize(mydb_stmt* stmt);
+
+// 把按 id 严格递增的 rows 批量加载到空表中，fill_percent 为页的填充率（1-100）；
+// id 不递增时返回 MYDB_DUPLICATE_KEY，表仍为空；表非空或句柄上有打开的迭代器时返回 MYDB_MISUSE；返回时已落盘
+int mydb_bulk_load(mydb* db, const mydb_row* rows, uint32_t num_rows, uint32_t fill_percent);
+
+// 按 id 点查
+int mydb_get(mydb* db, uint32_t id, mydb_row* row);
+
+// 删除 id 在 [start_id, end_id] 内的行，deleted 不为 NULL 时返回删除的行数；句柄上有打开的迭代器时返回 MYDB_MISUSE；
+// 与 mydb_step 一样，删除还在等组提交落盘时返回 MYDB_PENDING
+int mydb_delete_range(mydb* db, uint32_t start_id, uint32_t end_id, uint64_t* deleted);
+
+// 按 id 范围 [start_id, end_id] 顺序扫描，mydb_scan_next 返回 MYDB_ROW 或 MYDB_DONE
+int mydb_scan_open(mydb* db, uint32_t start_id, uint32_t end_id, mydb_iter** iter);
+int mydb_scan_next(mydb_iter* iter, mydb_row* row);
+void mydb_scan_close(mydb_iter* iter);
+
+// 结束尚未凑满的组提交，之前返回 MYDB_PENDING 的插入都已落盘
+int mydb_sync(mydb* db);
+
+// 把已提交的修改全部写回数据库文件并落盘
+int mydb_checkpoint(mydb* db);
+
+// 读写计数
+int mydb_stats_get(mydb* db, mydb_stats* stats);
+void mydb_stats_reset(mydb* db);
+
+#endif
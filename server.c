@@ -0,0 +1,593 @@
+/**
+ * server.c: Unix 域套接字上的本地服务模式，协议见 server.h
+ * 说明: 单线程 epoll 事件循环（水平触发）。每一轮先把所有就绪连接上的完整请求执行完，
+ *      再用一次 pager_sync 结束组提交，最后统一发送回复，多个客户端的插入共享一次 fdatasync
+ */
+#include "server.h"
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SERVER_MAX_EVENTS 64
+#define SERVER_BACKLOG 128
+#define SERVER_READ_SIZE (64 * 1024)                // 每次从连接读取的字节数
+#define SERVER_MAX_PENDING_OUTPUT (4 * 1024 * 1024) // 待发送的回复超过该值时暂停处理该连接的请求
+#define SERVER_ROW_MIN_SIZE (sizeof(uint32_t) + 2)  // id 加两个长度字节
+
+/**
+ * Connection 一个客户端连接
+ * events: 当前在 epoll 中注册的事件
+ * input / input_length: 已收到、尚未处理的字节
+ * output / output_start / output_length: 回复缓冲区，[output_start, output_length) 尚未发出
+ * output_synced: 这之前的回复对应的修改都已落盘，可以发出
+ * scanning / scan_next / scan_end: 正在执行的范围扫描，回复太多时分几轮产出，每轮重新定位游标
+ * end_of_input: 对端已关闭写方向，回复发完后关闭连接
+ * hung_up: 对端已完全关闭，回复发不出去: 接收缓冲区里剩下的请求照常执行，回复直接丢弃
+ * closed: 已关闭，等本轮结束后释放
+ * pending / next_pending: 本轮有新回复或已关闭，挂在待发送链表上
+ * prev / next: 所有连接组成的链表，退出时逐个关闭
+ */
+typedef struct Connection{
+    int fd;
+    uint32_t events;
+    uint8_t* input;
+    size_t input_length;
+    size_t input_capacity;
+    uint8_t* output;
+    size_t output_start;
+    size_t output_length;
+    size_t output_capacity;
+    size_t output_synced;
+    bool scanning;
+    uint32_t scan_next;
+    uint32_t scan_end;
+    bool end_of_input;
+    bool hung_up;
+    bool closed;
+    bool pending;
+    struct Connection* next_pending;
+    struct Connection* prev;
+    struct Connection* next;
+}Connection;
+
+/**
+ * Server 服务状态
+ * listen_fd / signal_fd: 监听套接字和接收 SIGINT/SIGTERM 的 signalfd
+ * connections: 所有打开的连接
+ * pending: 本轮需要发送回复的连接
+ */
+typedef struct{
+    Table* table;
+    int epoll_fd;
+    int listen_fd;
+    int signal_fd;
+    Connection* connections;
+    Connection* pending;
+}Server;
+
+/**
+ * connection_pending_output: 尚未发出的回复字节数
+ */
+static size_t connection_pending_output(Connection* connection){
+    return connection->output_length - connection->output_start;
+}
+
+/**
+ * connection_update_events: 按缓冲区状态调整关注的事件
+ * 说明: 待发送的回复过多或对端已关闭写方向时不再关注可读，避免水平触发下空转；
+ *      有可以发出的回复时关注可写
+ */
+static void connection_update_events(Server* server, Connection* connection){
+    uint32_t events = 0;
+    if(!connection->end_of_input && connection_pending_output(connection) < SERVER_MAX_PENDING_OUTPUT){
+        events |= EPOLLIN;
+    }
+    if(connection->output_synced > connection->output_start){
+        events |= EPOLLOUT;
+    }
+    if(events == connection->events){
+        return;
+    }
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = connection;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+    connection->events = events;
+}
+
+/**
+ * connection_close: 关闭连接
+ * 说明: 本轮中调用方关闭之后还会检查 closed，所以连接不在这里释放，
+ *      而是挂到待发送链表上，由 server_flush_pending 在本轮结束时释放
+ */
+static void connection_close(Server* server, Connection* connection){
+    if(connection->closed){
+        return;
+    }
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, connection->fd, NULL);
+    close(connection->fd);
+    connection->closed = true;
+    if(connection->prev != NULL){
+        connection->prev->next = connection->next;
+    }
+    else{
+        server->connections = connection->next;
+    }
+    if(connection->next != NULL){
+        connection->next->prev = connection->prev;
+    }
+    if(!connection->pending){
+        connection->pending = true;
+        connection->next_pending = server->pending;
+        server->pending = connection;
+    }
+}
+
+/**
+ * connection_hang_up: 对端已完全关闭，丢掉所有回复
+ * 说明: 流水线客户端可能发完请求不等回复就关闭连接，已经收到的请求仍然要执行，
+ *      连接保持打开直到读到输入结尾；扫描的结果没人接收，直接结束
+ */
+static void connection_hang_up(Connection* connection){
+    connection->hung_up = true;
+    connection->scanning = false;
+    connection->output_start = 0;
+    connection->output_length = 0;
+    connection->output_synced = 0;
+}
+
+/**
+ * connection_reserve_output: 保证回复缓冲区还能追加 size 字节
+ */
+static void connection_reserve_output(Connection* connection, size_t size){
+    if(connection->output_start > 0 && connection->output_length + size > connection->output_capacity){
+        // 先把已发出的部分挪掉
+        memmove(connection->output, connection->output + connection->output_start,
+                connection_pending_output(connection));
+        connection->output_length -= connection->output_start;
+        connection->output_synced -= connection->output_start;
+        connection->output_start = 0;
+    }
+    if(connection->output_length + size > connection->output_capacity){
+        size_t capacity = connection->output_capacity > 0 ? connection->output_capacity : SERVER_READ_SIZE;
+        while(capacity < connection->output_length + size){
+            capacity *= 2;
+        }
+        connection->output = (uint8_t*)realloc(connection->output, capacity);
+        connection->output_capacity = capacity;
+    }
+}
+
+/**
+ * connection_reply: 追加一个回复帧
+ */
+static void connection_reply(Server* server, Connection* connection, ServerStatus status,
+                             const void* payload, uint32_t payload_length){
+    if(connection->hung_up){
+        return;
+    }
+    uint32_t length = 1 + payload_length;
+    connection_reserve_output(connection, SERVER_LENGTH_SIZE + length);
+    uint8_t* frame = connection->output + connection->output_length;
+    memcpy(frame, &length, SERVER_LENGTH_SIZE);
+    frame[SERVER_LENGTH_SIZE] = (uint8_t)status;
+    if(payload_length > 0){
+        memcpy(frame + SERVER_LENGTH_SIZE + 1, payload, payload_length);
+    }
+    connection->output_length += SERVER_LENGTH_SIZE + length;
+    if(!connection->pending){
+        connection->pending = true;
+        connection->next_pending = server->pending;
+        server->pending = connection;
+    }
+}
+
+/**
+ * server_insert: 执行插入请求，负载就是序列化后的行
+ */
+static void server_insert(Server* server, Connection* connection, const uint8_t* payload, uint32_t length){
+    if(length < SERVER_ROW_MIN_SIZE){
+        connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    uint32_t id;
+    memcpy(&id, payload, sizeof(id));
+    uint32_t username_length = payload[sizeof(id)];
+    if(length < SERVER_ROW_MIN_SIZE + username_length){
+        connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    const uint8_t* username = payload + sizeof(id) + 1;
+    uint32_t email_length = username[username_length];
+    const uint8_t* email = username + username_length + 1;
+    if(length != SERVER_ROW_MIN_SIZE + username_length + email_length){
+        connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    if(username_length > COLUMN_USERNAME_SIZE){
+        connection_reply(server, connection, SERVER_TOO_LONG, NULL, 0);
+        return;
+    }
+
+    Statement statement;
+    statement_set_insert_row(&statement, id, (const char*)username, username_length,
+                             (const char*)email, email_length);
+    ExecuteResult result = execute_insert(&statement, server->table);
+    connection_reply(server, connection, result == EXECUTE_DUPLICATE_KEY ? SERVER_DUPLICATE_KEY : SERVER_OK,
+                     NULL, 0);
+}
+
+/**
+ * server_get: 执行点查请求
+ */
+static void server_get(Server* server, Connection* connection, const uint8_t* payload, uint32_t length){
+    uint32_t id;
+    if(length != sizeof(id)){
+        connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    memcpy(&id, payload, sizeof(id));
+    Cursor cursor;
+    table_seek(server->table, id, &cursor);
+    if(!cursor.end_of_table && *(uint32_t*)cursor_value(&cursor) == id){
+        void* value = cursor_value(&cursor);
+        connection_reply(server, connection, SERVER_ROW, value, stored_row_size(value));
+    }
+    else{
+        connection_reply(server, connection, SERVER_NOT_FOUND, NULL, 0);
+    }
+    cursor_close(&cursor);
+}
+
+/**
+ * connection_continue_scan: 从 scan_next 继续产出扫描结果，直到扫完或待发送的回复过多
+ * 说明: 每轮结束都关闭游标，不会在等客户端接收期间一直持有页锁
+ */
+static void connection_continue_scan(Server* server, Connection* connection){
+    bool finished = false;
+    Cursor cursor;
+    table_seek(server->table, connection->scan_next, &cursor);
+    while(connection_pending_output(connection) < SERVER_MAX_PENDING_OUTPUT){
+        if(cursor.end_of_table){
+            finished = true;
+            break;
+        }
+        void* value = cursor_value(&cursor);
+        uint32_t id = *(uint32_t*)value;
+        if(id > connection->scan_end){
+            finished = true;
+            break;
+        }
+        connection_reply(server, connection, SERVER_ROW, value, stored_row_size(value));
+        if(id == connection->scan_end){
+            finished = true;
+            break;
+        }
+        connection->scan_next = id + 1;
+        cursor_advance(&cursor);
+    }
+    cursor_close(&cursor);
+    if(finished){
+        connection->scanning = false;
+        connection_reply(server, connection, SERVER_DONE, NULL, 0);
+    }
+}
+
+/**
+ * server_scan: 开始执行范围扫描请求
+ */
+static void server_scan(Server* server, Connection* connection, const uint8_t* payload, uint32_t length){
+    uint32_t start, end;
+    if(length != sizeof(start) + sizeof(end)){
+        connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    memcpy(&start, payload, sizeof(start));
+    memcpy(&end, payload + sizeof(start), sizeof(end));
+    if(start > end){
+        connection_reply(server, connection, SERVER_DONE, NULL, 0);
+        return;
+    }
+    connection->scanning = true;
+    connection->scan_next = start;
+    connection->scan_end = end;
+    connection_continue_scan(server, connection);
+}
+
+/**
+ * connection_process: 按顺序执行输入缓冲区中所有完整的请求帧
+ * 说明: 待发送的回复过多时暂停，剩下的请求留在缓冲区里，等回复发出去后再继续
+ * 返回值: 帧长度非法、无法再找到帧边界时返回 false，调用方关闭连接
+ */
+static bool connection_process(Server* server, Connection* connection){
+    size_t offset = 0;
+    bool valid = true;
+    while(connection_pending_output(connection) < SERVER_MAX_PENDING_OUTPUT){
+        if(connection->scanning){
+            connection_continue_scan(server, connection);
+            continue;
+        }
+        if(connection->input_length - offset < SERVER_LENGTH_SIZE){
+            break;
+        }
+        uint32_t length;
+        memcpy(&length, connection->input + offset, SERVER_LENGTH_SIZE);
+        if(length == 0 || length > SERVER_MAX_REQUEST_SIZE){
+            valid = false;
+            break;
+        }
+        if(connection->input_length - offset - SERVER_LENGTH_SIZE < length){
+            break;
+        }
+        const uint8_t* request = connection->input + offset + SERVER_LENGTH_SIZE;
+        offset += SERVER_LENGTH_SIZE + length;
+        switch(request[0]){
+            case SERVER_OP_INSERT:
+                server_insert(server, connection, request + 1, length - 1);
+                break;
+            case SERVER_OP_GET:
+                server_get(server, connection, request + 1, length - 1);
+                break;
+            case SERVER_OP_SCAN:
+                server_scan(server, connection, request + 1, length - 1);
+                break;
+            default:
+                connection_reply(server, connection, SERVER_BAD_REQUEST, NULL, 0);
+                break;
+        }
+    }
+    connection->input_length -= offset;
+    memmove(connection->input, connection->input + offset, connection->input_length);
+    return valid;
+}
+
+/**
+ * connection_finish: 对端已关闭写方向且回复都已发出时关闭连接，否则更新关注的事件
+ * 说明: 输入中剩下的不完整请求帧被丢弃
+ */
+static void connection_finish(Server* server, Connection* connection){
+    if(connection->end_of_input && !connection->scanning && connection_pending_output(connection) == 0){
+        connection_close(server, connection);
+        return;
+    }
+    connection_update_events(server, connection);
+}
+
+/**
+ * connection_read: 读取一次数据并执行其中完整的请求
+ */
+static void connection_read(Server* server, Connection* connection){
+    if(connection->input_capacity - connection->input_length < SERVER_READ_SIZE){
+        connection->input_capacity = connection->input_length + SERVER_READ_SIZE;
+        connection->input = (uint8_t*)realloc(connection->input, connection->input_capacity);
+    }
+    ssize_t bytes_read = read(connection->fd, connection->input + connection->input_length, SERVER_READ_SIZE);
+    if(bytes_read == -1 && errno != EAGAIN && errno != EINTR){
+        connection_close(server, connection);
+        return;
+    }
+    if(bytes_read == 0){
+        connection->end_of_input = true;
+    }
+    if(bytes_read > 0){
+        connection->input_length += bytes_read;
+    }
+    if(!connection_process(server, connection)){
+        connection_close(server, connection);
+        return;
+    }
+    connection_finish(server, connection);
+}
+
+/**
+ * connection_write: 尽量发出已落盘的回复，然后继续执行之前因回复太多而暂停的请求
+ */
+static void connection_write(Server* server, Connection* connection){
+    while(connection->output_synced > connection->output_start){
+        ssize_t bytes_written = send(connection->fd, connection->output + connection->output_start,
+                                     connection->output_synced - connection->output_start, MSG_NOSIGNAL);
+        if(bytes_written == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            if(errno == EPIPE || errno == ECONNRESET){
+                connection_hang_up(connection);
+                break;
+            }
+            if(errno != EAGAIN){
+                connection_close(server, connection);
+                return;
+            }
+            break;
+        }
+        connection->output_start += bytes_written;
+    }
+    if(connection_pending_output(connection) == 0){
+        connection->output_start = 0;
+        connection->output_length = 0;
+        connection->output_synced = 0;
+    }
+    if(!connection_process(server, connection)){
+        connection_close(server, connection);
+        return;
+    }
+    connection_finish(server, connection);
+}
+
+/**
+ * server_accept: 接受所有等待中的连接
+ */
+static void server_accept(Server* server){
+    while(true){
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd == -1){
+            if(errno != EAGAIN && errno != EINTR){
+                printf("Error accepting connection: %s\n", strerror(errno));
+            }
+            return;
+        }
+        Connection* connection = (Connection*)calloc(1, sizeof(Connection));
+        connection->fd = fd;
+        connection->events = EPOLLIN;
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = connection;
+        if(epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1){
+            close(fd);
+            free(connection);
+            continue;
+        }
+        connection->next = server->connections;
+        if(server->connections != NULL){
+            server->connections->prev = connection;
+        }
+        server->connections = connection;
+    }
+}
+
+/**
+ * server_flush_pending: 结束组提交后发出本轮产生的回复，并释放本轮关闭的连接
+ * 说明: pager_sync 之后插入都已落盘，客户端收到 SERVER_OK 时数据不会因崩溃丢失
+ */
+static void server_flush_pending(Server* server){
+    if(server->pending == NULL){
+        return;
+    }
+    pager_sync(server->table->pager);
+    // connection_write 可能继续执行请求并产生新的回复，先把链表摘下来
+    while(server->pending != NULL){
+        Connection* connection = server->pending;
+        server->pending = NULL;
+        while(connection != NULL){
+            Connection* next = connection->next_pending;
+            connection->pending = false;
+            if(connection->closed){
+                free(connection->input);
+                free(connection->output);
+                free(connection);
+            }
+            else{
+                connection->output_synced = connection->output_length;
+                connection_write(server, connection);
+            }
+            connection = next;
+        }
+        if(server->pending != NULL){
+            pager_sync(server->table->pager);
+        }
+    }
+}
+
+/**
+ * server_listen: 创建监听套接字，路径上残留的旧套接字文件会被删除
+ */
+static int server_listen(const char* socket_path){
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(address.sun_path)){
+        printf("Socket path too long: %s\n", socket_path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        printf("Error creating socket: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    unlink(socket_path);
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1 || listen(fd, SERVER_BACKLOG) == -1){
+        printf("Error listening on %s: %s\n", socket_path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/**
+ * server_run: 在 socket_path 上提供服务，收到 SIGINT 或 SIGTERM 后关闭所有连接并返回
+ * 说明: 返回后由调用方 db_close，和 REPL 的 .exit 一样写回所有数据
+ */
+void server_run(Table* table, const char* socket_path){
+    Server server;
+    memset(&server, 0, sizeof(server));
+    server.table = table;
+    server.listen_fd = server_listen(socket_path);
+
+    // 信号通过 signalfd 进入事件循环，退出时不会打断正在执行的请求
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    server.signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    server.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(server.epoll_fd == -1 || server.signal_fd == -1){
+        printf("Error creating event loop: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = &server.listen_fd;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &event);
+    event.data.ptr = &server.signal_fd;
+    epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.signal_fd, &event);
+
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    bool running = true;
+    while(running){
+        int num_events = epoll_wait(server.epoll_fd, events, SERVER_MAX_EVENTS, -1);
+        if(num_events == -1){
+            if(errno == EINTR){
+                continue;
+            }
+            printf("Error waiting for events: %s\n", strerror(errno));
+            break;
+        }
+        for(int i = 0; i < num_events; i++){
+            void* source = events[i].data.ptr;
+            if(source == &server.listen_fd){
+                server_accept(&server);
+            }
+            else if(source == &server.signal_fd){
+                // 读走信号，否则解除屏蔽时它会照常递送
+                struct signalfd_siginfo info;
+                if(read(server.signal_fd, &info, sizeof(info)) == sizeof(info)){
+                    running = false;
+                }
+            }
+            else{
+                Connection* connection = (Connection*)source;
+                if(connection->closed){
+                    continue;
+                }
+                if(events[i].events & (EPOLLERR | EPOLLHUP)){
+                    // 对端没读回复就关闭时 EPOLLERR、EPOLLHUP 和 EPOLLIN 一起到达，
+                    // 接收缓冲区里的请求读完执行后再关闭
+                    connection_hang_up(connection);
+                }
+                if(events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)){
+                    connection_read(&server, connection);
+                }
+                if((events[i].events & EPOLLOUT) && !connection->closed){
+                    connection_write(&server, connection);
+                }
+            }
+        }
+        server_flush_pending(&server);
+    }
+
+    // 已执行的插入在 db_close 时写回，未发出的回复直接丢弃
+    while(server.connections != NULL){
+        connection_close(&server, server.connections);
+    }
+    server_flush_pending(&server);
+    close(server.listen_fd);
+    close(server.signal_fd);
+    close(server.epoll_fd);
+    unlink(socket_path);
+    sigprocmask(SIG_UNBLOCK, &signals, NULL);
+}
@@ -0,0 +1,50 @@
+/**
+ * server.h: 本地服务模式（main <db file> --serve <socket>）
+ * 说明: 在 Unix 域套接字上监听，用一个 epoll 事件循环服务所有连接，请求都在同一个 Table 上执行。
+ *      客户端可以连续发送多个请求而不等回复（流水线），回复按请求顺序返回。
+ *
+ * 协议: 请求和回复都是帧，整数使用本机字节序（只在同一台机器上通信）
+ *      帧: uint32 长度（不含长度字段本身） + uint8 操作码/状态 + 负载
+ *      行: uint32 id + uint8 用户名长度 + 用户名 + uint8 邮箱长度 + 邮箱（与页中存储的格式相同）
+ *
+ *      SERVER_OP_INSERT 负载为一行 -> SERVER_OK / SERVER_DUPLICATE_KEY / SERVER_TOO_LONG
+ *      SERVER_OP_GET    负载为 uint32 id -> SERVER_ROW + 行 / SERVER_NOT_FOUND
+ *      SERVER_OP_SCAN   负载为 uint32 起始 id + uint32 结束 id（都包含）
+ *                       -> 每行一个 SERVER_ROW 帧，最后一个 SERVER_DONE 帧
+ *      负载格式不对时回复 SERVER_BAD_REQUEST；长度超过 SERVER_MAX_REQUEST_SIZE 时直接断开连接。
+ *      启用预写日志时，插入的回复在提交落盘之后才发出。
+ *      服务端为每个连接最多积压几 MB 未发出的回复，超过后暂停读取该连接，流水线客户端需要边发边收
+ */
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "db.h"
+
+#define SERVER_LENGTH_SIZE sizeof(uint32_t)
+#define SERVER_MAX_REQUEST_SIZE 1024    // 请求帧（不含长度字段）的最大长度
+
+/**
+ * ServerOpcode 请求操作码
+ */
+typedef enum{
+    SERVER_OP_INSERT = 1,
+    SERVER_OP_GET = 2,
+    SERVER_OP_SCAN = 3
+}ServerOpcode;
+
+/**
+ * ServerStatus 回复状态
+ */
+typedef enum{
+    SERVER_OK = 0,
+    SERVER_ROW = 1,
+    SERVER_DONE = 2,
+    SERVER_NOT_FOUND = 3,
+    SERVER_DUPLICATE_KEY = 4,
+    SERVER_TOO_LONG = 5,
+    SERVER_BAD_REQUEST = 6
+}ServerStatus;
+
+void server_run(Table* table, const char* socket_path);
+
+#endif
@@ -0,0 +1,523 @@
+/**
+ * test.c: 基于 libmydb 的回归测试，由 make test 运行
+ * 说明: 每个测试在临时目录中新建自己的数据库；检查失败时打印位置后继续，
+ *      全部跑完后有失败则退出码非 0。用法: mydb_test [测试名...]，不带参数时运行全部测试
+ */
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "mydb.h"
+
+#define TEST_FILENAME_SIZE 512
+
+char test_directory[] = "/tmp/mydb_test.XXXXXX";
+const char* current_test;
+int failures;
+
+#define CHECK(condition) do{ \
+        if(!(condition)){ \
+            printf("%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, current_test, #condition); \
+            failures++; \
+        } \
+    }while(0)
+
+/**
+ * next_random: xorshift64，测试之间互不影响，每个测试开始时重置种子；读线程各用自己的状态
+ */
+uint64_t random_state;
+
+uint64_t next_random_from(uint64_t* state){
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+uint64_t next_random(){
+    return next_random_from(&random_state);
+}
+
+/**
+ * test_filename: 临时目录中的数据库文件名，先删掉上一次留下的数据库和日志
+ */
+const char* test_filename(const char* name){
+    static char filename[TEST_FILENAME_SIZE];
+    char wal_filename[TEST_FILENAME_SIZE + 8];
+    snprintf(filename, sizeof(filename), "%s/%s.db", test_directory, name);
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+    unlink(filename);
+    unlink(wal_filename);
+    return filename;
+}
+
+mydb* open_database(const char* filename, const mydb_options* options){
+    mydb* db;
+    if(mydb_open(filename, options, &db) != MYDB_OK){
+        printf("%s: cannot open %s: %s\n", current_test, filename, mydb_errmsg(db));
+        exit(EXIT_FAILURE);
+    }
+    return db;
+}
+
+/**
+ * insert_row: 插入一行，用户名和邮箱由 id 生成
+ * 返回值: mydb_step 的结果，组提交中尚未落盘的插入按成功处理
+ */
+int insert_row(mydb_stmt* stmt, uint32_t id){
+    char username[MYDB_USERNAME_MAX + 1];
+    char email[MYDB_EMAIL_MAX + 1];
+    int username_length = snprintf(username, sizeof(username), "user%u", id);
+    int email_length = snprintf(email, sizeof(email), "user%u@example.com", id);
+    mydb_bind_id(stmt, id);
+    mydb_bind_username(stmt, username, username_length);
+    mydb_bind_email(stmt, email, email_length);
+    int rc = mydb_step(stmt);
+    mydb_reset(stmt);
+    return rc == MYDB_PENDING ? MYDB_OK : rc;
+}
+
+/**
+ * row_matches: 行是否是 insert_row 为 id 生成的那一行
+ */
+bool row_matches(const mydb_row* row, uint32_t id){
+    char username[MYDB_USERNAME_MAX + 1];
+    char email[MYDB_EMAIL_MAX + 1];
+    uint32_t username_length = snprintf(username, sizeof(username), "user%u", id);
+    uint32_t email_length = snprintf(email, sizeof(email), "user%u@example.com", id);
+    return row->id == id
+        && row->username_length == username_length && memcmp(row->username, username, username_length) == 0
+        && row->email_length == email_length && memcmp(row->email, email, email_length) == 0;
+}
+
+/**
+ * shuffled_ids: 返回 1..count 的随机排列
+ */
+uint32_t* shuffled_ids(uint32_t count){
+    uint32_t* ids = (uint32_t*)malloc(sizeof(uint32_t) * count);
+    for(uint32_t i = 0; i < count; i++){
+        ids[i] = i + 1;
+    }
+    for(uint32_t i = count - 1; i > 0; i--){
+        uint32_t j = next_random() % (i + 1);
+        uint32_t temp = ids[i];
+        ids[i] = ids[j];
+        ids[j] = temp;
+    }
+    return ids;
+}
+
+/**
+ * count_mismatches: 扫描整张表，与 present[1..count] 比较
+ * 返回值: 缺少、多出、内容不对或者顺序不对的行数
+ */
+uint32_t count_mismatches(mydb* db, const bool* present, uint32_t count){
+    uint32_t mismatches = 0;
+    uint32_t expected = 1;
+    mydb_iter* iter;
+    mydb_row row;
+    mydb_scan_open(db, 0, UINT32_MAX, &iter);
+    while(mydb_scan_next(iter, &row) == MYDB_ROW){
+        while(expected <= count && !present[expected]){
+            expected++;
+        }
+        if(row.id != expected || !row_matches(&row, row.id)){
+            mismatches++;
+        }
+        expected = row.id + 1;
+    }
+    mydb_scan_close(iter);
+    for(; expected <= count; expected++){
+        mismatches += present[expected];
+    }
+    return mismatches;
+}
+
+/**
+ * test_multi_level_tree: 随机顺序插入足够多的行，使根之下至少有两层内部节点，
+ * 逐个点查并全表扫描，关闭重新打开后再查一遍
+ */
+void test_multi_level_tree(){
+    const uint32_t count = 100000;
+    const char* filename = test_filename("multi_level");
+    mydb* db = open_database(filename, NULL);
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    uint32_t* ids = shuffled_ids(count);
+    bool* present = (bool*)calloc(count + 1, sizeof(bool));
+    uint32_t failed_inserts = 0;
+    for(uint32_t i = 0; i < count; i++){
+        failed_inserts += insert_row(stmt, ids[i]) != MYDB_OK;
+        present[ids[i]] = true;
+    }
+    CHECK(failed_inserts == 0);
+    CHECK(insert_row(stmt, ids[count / 2]) == MYDB_DUPLICATE_KEY);
+    mydb_finalize(stmt);
+
+    for(int pass = 0; pass < 2; pass++){
+        uint32_t missing = 0;
+        mydb_row row;
+        for(uint32_t id = 1; id <= count; id++){
+            missing += mydb_get(db, id, &row) != MYDB_OK || !row_matches(&row, id);
+        }
+        CHECK(missing == 0);
+        CHECK(mydb_get(db, count + 1, &row) == MYDB_NOT_FOUND);
+        CHECK(mydb_get(db, 0, &row) == MYDB_NOT_FOUND);
+        CHECK(count_mismatches(db, present, count) == 0);
+
+        mydb_close(db);
+        db = open_database(filename, NULL);
+    }
+
+    // 每页一百来行，十万行至少要一千个叶子，超过一个 4KB 内部节点的五百多个孩子
+    mydb_stats stats;
+    mydb_stats_get(db, &stats);
+    CHECK(stats.page_size == 4096);
+    CHECK(stats.page_count > 1000);
+    mydb_close(db);
+    free(present);
+    free(ids);
+}
+
+/**
+ * test_wal_recovery: 子进程在日志模式下插入后不关闭数据库直接退出，模拟崩溃；
+ * 日志末尾再接上一段不完整的帧。重新打开时应当重放日志中的每个完整提交，丢弃末尾的残帧
+ */
+void test_wal_recovery(){
+    const uint32_t synced = 3000;
+    const uint32_t unsynced = 100;
+    const char* filename = test_filename("wal_recovery");
+    mydb_options options;
+    mydb_options_init(&options);
+    options.use_wal = true;
+    options.wal_group_commit = 64;
+
+    pid_t pid = fork();
+    if(pid == 0){
+        mydb* db = open_database(filename, &options);
+        mydb_stmt* stmt;
+        mydb_prepare_insert(db, &stmt);
+        for(uint32_t id = 1; id <= synced; id++){
+            insert_row(stmt, id);
+        }
+        mydb_sync(db);
+        // 组提交还没有落盘的插入，进程退出后仍在操作系统的页缓存里
+        for(uint32_t id = synced + 1; id <= synced + unsynced; id++){
+            insert_row(stmt, id);
+        }
+        _exit(EXIT_SUCCESS);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    char wal_filename[TEST_FILENAME_SIZE + 8];
+    snprintf(wal_filename, sizeof(wal_filename), "%s-wal", filename);
+    struct stat wal_stat;
+    CHECK(stat(wal_filename, &wal_stat) == 0 && wal_stat.st_size > 0);
+    FILE* wal = fopen(wal_filename, "a");
+    char torn_frame[1000];
+    memset(torn_frame, 0x5a, sizeof(torn_frame));
+    fwrite(torn_frame, 1, sizeof(torn_frame), wal);
+    fclose(wal);
+
+    // 每个插入是一次提交: 恢复出来的必须是插入顺序的一个前缀，且包含 mydb_sync 之前的全部插入
+    const uint32_t total = synced + unsynced;
+    mydb* db = open_database(filename, &options);
+    uint32_t recovered = 0;
+    mydb_row row;
+    while(recovered < total && mydb_get(db, recovered + 1, &row) == MYDB_OK && row_matches(&row, recovered + 1)){
+        recovered++;
+    }
+    CHECK(recovered >= synced);
+    bool* present = (bool*)calloc(total + 2, sizeof(bool));
+    memset(present + 1, true, recovered);
+    CHECK(count_mismatches(db, present, total + 1) == 0);
+
+    // 恢复后的数据库照常可写，正常关闭（检查点）后再打开，内容不变
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    CHECK(insert_row(stmt, total + 1) == MYDB_OK);
+    CHECK(insert_row(stmt, 1) == MYDB_DUPLICATE_KEY);
+    present[total + 1] = true;
+    mydb_finalize(stmt);
+    mydb_close(db);
+
+    db = open_database(filename, &options);
+    CHECK(count_mismatches(db, present, total + 1) == 0);
+    mydb_close(db);
+    free(present);
+}
+
+/**
+ * fill_string: 生成 id 对应的定长字符串，内容随 id 和位置变化
+ */
+void fill_string(char* buffer, uint32_t id, uint32_t length){
+    for(uint32_t i = 0; i < length; i++){
+        buffer[i] = 'a' + (id + i) % 26;
+    }
+}
+
+/**
+ * insert_sized_row: 插入用户名和邮箱为指定长度的一行
+ */
+int insert_sized_row(mydb_stmt* stmt, uint32_t id, uint32_t username_length, uint32_t email_length){
+    char username[MYDB_USERNAME_MAX];
+    char email[MYDB_EMAIL_MAX];
+    fill_string(username, id, username_length);
+    fill_string(email, id * 7, email_length);
+    mydb_bind_id(stmt, id);
+    mydb_bind_username(stmt, username, username_length);
+    mydb_bind_email(stmt, email, email_length);
+    int rc = mydb_step(stmt);
+    mydb_reset(stmt);
+    return rc;
+}
+
+bool sized_row_matches(const mydb_row* row, uint32_t id, uint32_t username_length, uint32_t email_length){
+    char username[MYDB_USERNAME_MAX];
+    char email[MYDB_EMAIL_MAX];
+    fill_string(username, id, username_length);
+    fill_string(email, id * 7, email_length);
+    return row->id == id
+        && row->username_length == username_length && memcmp(row->username, username, username_length) == 0
+        && row->email_length == email_length && memcmp(row->email, email, email_length) == 0;
+}
+
+/**
+ * test_variable_length_rows: 从空串到列宽上限的各种长度都能原样读回；
+ * 短行按实际长度存放，每页能放下的行数远多于定长的 13 行
+ */
+void test_variable_length_rows(){
+    const uint32_t count = 2000;
+    const char* filename = test_filename("variable_length");
+    mydb* db = open_database(filename, NULL);
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    uint32_t failed_inserts = 0;
+    for(uint32_t id = 1; id <= count; id++){
+        failed_inserts += insert_sized_row(stmt, id, id % (MYDB_USERNAME_MAX + 1), id % (MYDB_EMAIL_MAX + 1)) != MYDB_OK;
+    }
+    CHECK(failed_inserts == 0);
+    char too_long[MYDB_EMAIL_MAX + 1];
+    memset(too_long, 'x', sizeof(too_long));
+    CHECK(mydb_bind_username(stmt, too_long, MYDB_USERNAME_MAX + 1) == MYDB_TOO_LONG);
+    CHECK(mydb_bind_email(stmt, too_long, MYDB_EMAIL_MAX + 1) == MYDB_TOO_LONG);
+    mydb_finalize(stmt);
+    mydb_close(db);
+
+    db = open_database(filename, NULL);
+    uint32_t mismatches = 0;
+    mydb_row row;
+    for(uint32_t id = 1; id <= count; id++){
+        mismatches += mydb_get(db, id, &row) != MYDB_OK
+                   || !sized_row_matches(&row, id, id % (MYDB_USERNAME_MAX + 1), id % (MYDB_EMAIL_MAX + 1));
+    }
+    CHECK(mismatches == 0);
+    mydb_close(db);
+
+    // 约 30 字节的行: 定长编码要 10000 / 13 个叶子，变长编码每页放得下约 90 行
+    filename = test_filename("variable_length_dense");
+    db = open_database(filename, NULL);
+    mydb_prepare_insert(db, &stmt);
+    for(uint32_t id = 1; id <= 10000; id++){
+        insert_sized_row(stmt, id, 8, 20);
+    }
+    mydb_finalize(stmt);
+    mydb_stats stats;
+    mydb_stats_get(db, &stats);
+    CHECK(stats.page_count < 10000 / 60);
+    mydb_close(db);
+}
+
+/**
+ * test_leaf_compaction: 反复删除一行再插回更长的同一行，叶子中留下的空洞
+ * 要在整理碎片后才能放下新行；整理和随后的分裂都不能弄丢或弄乱其他行
+ */
+void test_leaf_compaction(){
+    const uint32_t count = 60;
+    const char* filename = test_filename("leaf_compaction");
+    mydb* db = open_database(filename, NULL);
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    uint32_t email_lengths[count + 1];
+    for(uint32_t id = 1; id <= count; id++){
+        email_lengths[id] = 10;
+        insert_sized_row(stmt, id, 4, email_lengths[id]);
+    }
+
+    uint32_t mismatches = 0;
+    for(uint32_t round = 0; round < 4; round++){
+        for(uint32_t id = 1 + round % 2; id <= count; id += 2){
+            uint64_t deleted = 0;
+            mydb_delete_range(db, id, id, &deleted);
+            mismatches += deleted != 1;
+            email_lengths[id] = email_lengths[id] == 10 ? 200 : email_lengths[id] - 60;
+            mismatches += insert_sized_row(stmt, id, 4, email_lengths[id]) != MYDB_OK;
+        }
+        mydb_row row;
+        for(uint32_t id = 1; id <= count; id++){
+            mismatches += mydb_get(db, id, &row) != MYDB_OK || !sized_row_matches(&row, id, 4, email_lengths[id]);
+        }
+    }
+    CHECK(mismatches == 0);
+    mydb_finalize(stmt);
+    mydb_close(db);
+}
+
+#define CONCURRENT_STABLE_ROWS 2000   // 并发测试中一直存在的行: id 为 10 的倍数
+#define CONCURRENT_READERS 4
+
+/**
+ * ConcurrentReader 并发测试中一个读线程的参数和结果
+ * stop: 写线程做完后置位
+ * errors: 顺序不对、内容不对或者缺少稳定行的次数
+ */
+typedef struct{
+    const char* filename;
+    bool* stop;
+    uint64_t random_state;
+    uint32_t errors;
+}ConcurrentReader;
+
+void* concurrent_reader_main(void* arg){
+    ConcurrentReader* reader = (ConcurrentReader*)arg;
+    // 同一文件的句柄共享引擎，读线程与写线程只在页闩上同步
+    mydb* db = open_database(reader->filename, NULL);
+    while(!__atomic_load_n(reader->stop, __ATOMIC_ACQUIRE)){
+        mydb_iter* iter;
+        mydb_row row;
+        uint32_t previous = 0;
+        uint32_t stable = 0;
+        mydb_scan_open(db, 0, UINT32_MAX, &iter);
+        while(mydb_scan_next(iter, &row) == MYDB_ROW){
+            reader->errors += row.id <= previous || !row_matches(&row, row.id);
+            stable += row.id % 10 == 0;
+            previous = row.id;
+            // 迭代器打开期间点查: 迭代器不持有叶子的读闩，不会和从根往下加锁的写线程互相等待
+            if(row.id % 100 == 0){
+                mydb_row found;
+                reader->errors += mydb_get(db, row.id, &found) != MYDB_OK || !row_matches(&found, row.id);
+            }
+        }
+        mydb_scan_close(iter);
+        reader->errors += stable != CONCURRENT_STABLE_ROWS;
+
+        for(uint32_t i = 0; i < 200; i++){
+            uint32_t id = 10 * (1 + next_random_from(&reader->random_state) % CONCURRENT_STABLE_ROWS);
+            reader->errors += mydb_get(db, id, &row) != MYDB_OK || !row_matches(&row, id);
+        }
+        // 让出处理器，读线程不会一直占着根节点的读闩把写线程饿住
+        usleep(100);
+    }
+    mydb_close(db);
+    return NULL;
+}
+
+/**
+ * test_concurrent_reads: 写线程乱序插入并删除稳定行之间的行，叶子和内部节点不断分裂、合并；
+ * 同时几个读线程反复扫描和点查（包括扫描中途点查），每次都必须看到全部稳定行，且扫描有序
+ */
+void test_concurrent_reads(){
+    const char* filename = test_filename("concurrent_reads");
+    mydb* db = open_database(filename, NULL);
+    mydb_stmt* stmt;
+    mydb_prepare_insert(db, &stmt);
+    for(uint32_t k = 1; k <= CONCURRENT_STABLE_ROWS; k++){
+        insert_row(stmt, 10 * k);
+    }
+
+    bool stop = false;
+    pthread_t threads[CONCURRENT_READERS];
+    ConcurrentReader readers[CONCURRENT_READERS];
+    for(uint32_t i = 0; i < CONCURRENT_READERS; i++){
+        readers[i] = (ConcurrentReader){filename, &stop, next_random() | 1, 0};
+        pthread_create(&threads[i], NULL, concurrent_reader_main, &readers[i]);
+    }
+
+    // 稳定行之间的 9 行: 每轮乱序插入后再按区间删掉，下一轮重新插入
+    uint32_t count = 10 * CONCURRENT_STABLE_ROWS;
+    uint32_t* ids = shuffled_ids(count);
+    uint32_t write_errors = 0;
+    for(uint32_t round = 0; round < 2; round++){
+        for(uint32_t i = 0; i < count; i++){
+            if(ids[i] % 10 != 0){
+                write_errors += insert_row(stmt, ids[i]) != MYDB_OK;
+            }
+        }
+        for(uint32_t k = 0; k < CONCURRENT_STABLE_ROWS; k++){
+            uint64_t deleted = 0;
+            mydb_delete_range(db, 10 * k + 1, 10 * k + 9, &deleted);
+            write_errors += deleted != 9;
+        }
+    }
+    __atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+
+    uint32_t read_errors = 0;
+    for(uint32_t i = 0; i < CONCURRENT_READERS; i++){
+        pthread_join(threads[i], NULL);
+        read_errors += readers[i].errors;
+    }
+    CHECK(write_errors == 0);
+    CHECK(read_errors == 0);
+
+    bool* present = (bool*)calloc(count + 1, sizeof(bool));
+    for(uint32_t k = 1; k <= CONCURRENT_STABLE_ROWS; k++){
+        present[10 * k] = true;
+    }
+    CHECK(count_mismatches(db, present, count) == 0);
+    free(present);
+    free(ids);
+    mydb_finalize(stmt);
+    mydb_close(db);
+}
+
+typedef struct{
+    const char* name;
+    void (*run)();
+}TestCase;
+
+TestCase test_cases[] = {
+    {"multi_level_tree", test_multi_level_tree},
+    {"wal_recovery", test_wal_recovery},
+    {"variable_length_rows", test_variable_length_rows},
+    {"leaf_compaction", test_leaf_compaction},
+    {"concurrent_reads", test_concurrent_reads},
+};
+
+int main(int argc, char** argv){
+    if(mkdtemp(test_directory) == NULL){
+        perror("mkdtemp");
+        return EXIT_FAILURE;
+    }
+    uint32_t num_cases = sizeof(test_cases) / sizeof(test_cases[0]);
+    uint32_t num_run = 0;
+    for(uint32_t i = 0; i < num_cases; i++){
+        bool selected = argc == 1;
+        for(int j = 1; j < argc; j++){
+            selected |= strcmp(argv[j], test_cases[i].name) == 0;
+        }
+        if(!selected){
+            continue;
+        }
+        current_test = test_cases[i].name;
+        random_state = 88172645463325252ull;
+        int failures_before = failures;
+        test_cases[i].run();
+        printf("%s %s\n", failures == failures_before ? "ok  " : "FAIL", current_test);
+        num_run++;
+    }
+
+    char command[TEST_FILENAME_SIZE];
+    snprintf(command, sizeof(command), "rm -rf %s", test_directory);
+    if(system(command) != 0){
+        printf("Cannot remove %s\n", test_directory);
+    }
+    printf("%u tests, %d failed checks\n", num_run, failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
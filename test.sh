@@ -0,0 +1,191 @@
+#!/bin/sh
+# test.sh: 以批处理模式驱动 REPL 的回归测试，由 make test 运行
+# 用法: sh test.sh [main 的路径]
+# 每个测试在临时目录中新建自己的数据库，把输出与预期比较；有失败时退出码非 0
+
+MAIN=${1:-./main}
+TEST_DIR=$(mktemp -d /tmp/mydb_test.XXXXXX)
+trap 'rm -rf "$TEST_DIR"' EXIT
+TESTS=0
+
+# fail: 记录当前测试的一次失败；检查可能在管道的子 shell 中运行，失败记到文件里
+fail(){
+    echo "$CURRENT_TEST: $*"
+    echo "$CURRENT_TEST" >> "$TEST_DIR/failures"
+}
+
+failures(){
+    cat "$TEST_DIR/failures" 2> /dev/null | wc -l
+}
+
+# run_main: 以批处理模式运行 main，语句从标准输入读入，
+# 输出写到 $TEST_DIR/out，错误写到 $TEST_DIR/err（标准输出是全缓冲的，两者不能混在一起比较）
+run_main(){
+    db=$1
+    shift
+    "$MAIN" "$TEST_DIR/$db" "$@" > "$TEST_DIR/out" 2> "$TEST_DIR/err"
+}
+
+# expect_file: 比较 run_main 写出的 out 或 err 与预期内容（从标准输入读入）
+expect_file(){
+    printf '%s' "$(cat)" > "$TEST_DIR/expected"
+    printf '%s' "$(cat "$TEST_DIR/$1")" > "$TEST_DIR/actual"
+    if ! cmp -s "$TEST_DIR/actual" "$TEST_DIR/expected"; then
+        fail "unexpected $1:"
+        diff "$TEST_DIR/expected" "$TEST_DIR/actual" | head -20
+    fi
+}
+
+expect_output(){
+    expect_file out
+}
+
+expect_errors(){
+    expect_file err
+}
+
+# insert_rows: 按 1..count 的一个固定排列（乘以与 count 互素的步长）生成插入语句
+insert_rows(){
+    awk -v count="$1" -v step="$2" 'BEGIN{
+        for(i = 0; i < count; i++){
+            id = (i * step) % count + 1
+            printf "insert %d user%d user%d@example.com\n", id, id, id
+        }
+    }'
+}
+
+# expected_rows: select 对 first..last 应当输出的行
+expected_rows(){
+    awk -v first="$1" -v last="$2" 'BEGIN{
+        for(id = first; id <= last; id++){
+            printf "(%d, user%d, user%d@example.com)\n", id, id, id
+        }
+    }'
+}
+
+# tree_depth: .btree 输出中最深的节点所在的层数（根为 1）
+tree_depth(){
+    awk '/^ *- (leaf|internal)/{ match($0, /^ */); d = RLENGTH / 2 + 1; if(d > max) max = d } END{ print max }' "$TEST_DIR/out"
+}
+
+# 多层 B+ 树: 乱序插入到根之下有两层内部节点，全表扫描和重新打开后结果不变
+test_multi_level_tree(){
+    count=60000
+    insert_rows $count 7919 > "$TEST_DIR/insert"
+    run_main multi.db < "$TEST_DIR/insert"
+    expect_output < /dev/null
+    expect_errors < /dev/null
+
+    echo "select" | run_main multi.db
+    expected_rows 1 $count | expect_output
+
+    echo ".btree" | run_main multi.db
+    depth=$(tree_depth)
+    [ "$depth" -ge 3 ] || fail "tree depth $depth, expected at least 3"
+
+    printf 'insert 1 again again@example.com\nselect where id = 30000\nselect where id = 60001\n' | run_main multi.db
+    expected_rows 30000 30000 | expect_output
+    echo "Error at line 1: Error: Duplicate key." | expect_errors
+}
+
+# stats_value: .stats 输出中某一项的值
+stats_value(){
+    awk -v name="$1" -F': *' '$1 ~ "^ *" name "$" { print $2 + 0 }' "$TEST_DIR/out"
+}
+
+# 顺序追加: 递增的 id 不从根下降，直接追加到最右叶子；最右节点分裂时旧节点保持满，
+# 新的右节点（包括内部节点）至少有一个键
+test_sequential_append(){
+    count=150000
+    { insert_rows $count 1; echo ".stats"; } | run_main append.db
+    appends=$(stats_value "fast appends")
+    leaf_splits=$(stats_value "leaf splits")
+    internal_splits=$(stats_value "internal splits")
+    [ "$appends" -ge $((count - leaf_splits - 1)) ] || fail "only $appends fast appends"
+    [ "$internal_splits" -ge 2 ] || fail "only $internal_splits internal splits"
+
+    echo ".btree" | run_main append.db
+    grep -q "internal (size 0)" "$TEST_DIR/out" && fail "internal node without keys"
+    # 每行约 40 字节，满叶子放 100 行左右；对半分裂时平均只有一半
+    fill=$(awk '/- leaf \(size/{ leaves++; rows += $4 } END{ print int(rows / leaves) }' "$TEST_DIR/out")
+    [ "$fill" -ge 90 ] || fail "leaves hold $fill rows on average"
+
+    # 删掉末尾后，比剩下的最大 id 大的 id 仍然走追加；比它小的 id 走普通插入
+    printf '%s\n' "delete where id between 149990 and 150000" \
+        "insert 149995 user149995 user149995@example.com" \
+        "insert 150002 user150002 user150002@example.com" \
+        "insert 149990 user149990 user149990@example.com" \
+        "insert 150002 again again@example.com" | run_main append.db
+    echo "Deleted 11 rows." | expect_output
+    echo "Error at line 5: Error: Duplicate key." | expect_errors
+
+    echo "select" | run_main append.db
+    { expected_rows 1 149990; expected_rows 149995 149995; expected_rows 150002 150002; } | expect_output
+}
+
+# 删除: 单行、范围和带字符串条件的删除报告删除的行数；过空的节点合并或从兄弟借，
+# 大部分行删掉后树变矮，全部删掉后只剩空的根叶子
+test_delete(){
+    count=60000
+    { echo "create index on username"; insert_rows $count 7919; } | run_main delete.db
+    printf '%s\n' "delete where id = 5" "delete where id = 5" "delete" \
+        "delete where id between 100 and 50000" \
+        "delete where id between 50001 and 60000 and username = user55555" \
+        "delete where username like user5999%" ".stats" | run_main delete.db
+    grep "^Deleted" "$TEST_DIR/out" > "$TEST_DIR/deleted"
+    {
+        echo "Deleted 1 rows."
+        echo "Deleted 0 rows."
+        echo "Deleted 49901 rows."
+        echo "Deleted 1 rows."
+        echo "Deleted 10 rows."
+    } | expect_file deleted
+    echo "Error at line 3: Syntax error. Could not parse statement." | expect_errors
+    merges=$(stats_value "merges")
+    [ "$merges" -gt 0 ] || fail "no merges"
+
+    echo "select" | run_main delete.db
+    {
+        expected_rows 1 4
+        expected_rows 6 99
+        expected_rows 50001 55554
+        expected_rows 55556 59989
+        expected_rows 60000 60000
+    } | expect_output
+
+    # 删除的行也从索引中删掉
+    printf '%s\n' "select id where username = user5" "select id where username = user55555" \
+        "select id where username = user59995" "select id where username = user50001" | run_main delete.db
+    echo "(50001)" | expect_output
+
+    echo ".btree" | run_main delete.db
+    depth=$(tree_depth)
+    [ "$depth" -eq 2 ] || fail "tree depth $depth after deleting most rows, expected 2"
+    grep -q "leaf (size 0)" "$TEST_DIR/out" && fail "empty leaf left in the tree"
+
+    printf '%s\n' "delete where id between 0 and 4294967295" ".btree" | run_main delete.db
+    printf '%s\n' "Deleted 10087 rows." "Tree:" "- leaf (size 0)" | expect_output
+
+    # 释放的页重新用于插入，文件不再变长
+    size_before=$(wc -c < "$TEST_DIR/delete.db")
+    insert_rows $count 7919 | run_main delete.db
+    size_after=$(wc -c < "$TEST_DIR/delete.db")
+    [ "$size_after" -le "$size_before" ] || fail "file grew from $size_before to $size_after bytes"
+    echo "select" | run_main delete.db
+    expected_rows 1 $count | expect_output
+}
+
+for test in test_multi_level_tree test_sequential_append test_delete; do
+    CURRENT_TEST=$test
+    failures_before=$(failures)
+    $test
+    if [ "$(failures)" -eq "$failures_before" ]; then
+        echo "ok   $test"
+    else
+        echo "FAIL $test"
+    fi
+    TESTS=$((TESTS + 1))
+done
+
+echo "$TESTS tests, $(failures) failed checks"
+[ "$(failures)" -eq 0 ]